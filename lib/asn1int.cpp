@@ -125,6 +125,39 @@ a1int &a1int::setRaw(const unsigned char *data, unsigned len)
 	return *this;
 }
 
+/* The value for integers up to 64 bit, the big endian bytes
+ * without leading zeros for larger ones */
+QVariant a1int::sortKey() const
+{
+	const unsigned char *d = in->data;
+	int len = in->length;
+	quint64 v = 0;
+
+	while (len > 0 && *d == 0) {
+		d++;
+		len--;
+	}
+	if (len > 8)
+		return QVariant(QByteArray((const char *)d, len));
+	for (int i = 0; i < len; i++)
+		v = (v << 8) | d[i];
+	return QVariant((qulonglong)v);
+}
+
+/* Equal integers give equal keys, see operator == */
+QByteArray a1int::hashKey() const
+{
+	const unsigned char *d = in->data;
+	int len = in->length;
+
+	while (len > 0 && *d == 0) {
+		d++;
+		len--;
+	}
+	QByteArray ba(1, (in->type & V_ASN1_NEG) ? '-' : '+');
+	return ba + QByteArray((const char *)d, len);
+}
+
 ASN1_INTEGER *a1int::get() const
 {
 	return dup(in);
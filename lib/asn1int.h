@@ -9,6 +9,7 @@
 #define __ASN1INTEGER_H
 
 #include <QString>
+#include <QVariant>
 #include <openssl/asn1.h>
 
 class a1int
@@ -30,6 +31,8 @@ class a1int
         a1int &setDec(const QString &s);
         a1int &setRaw(const unsigned char *data, unsigned len);
 	long getLong() const;
+	QVariant sortKey() const;
+	QByteArray hashKey() const;
 	ASN1_INTEGER *get() const;
 	QByteArray i2d();
 	int derSize() const;
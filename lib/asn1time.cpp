@@ -9,6 +9,7 @@
 #include "func.h"
 #include "exception.h"
 #include <time.h>
+#include <limits.h>
 #include "asn1time.h"
 #include <openssl/x509.h>
 #include <openssl/err.h>
@@ -174,6 +175,17 @@ QString a1time::toSortable() const
 	return toUTC().toString("yyyy-MM-dd");
 }
 
+/* Seconds since the epoch, sorting broken and undefined
+ * dates after all others like toSortable() does */
+qint64 a1time::sortKey() const
+{
+	if (isUndefined())
+		return LLONG_MAX;
+	if (!isValid())
+		return LLONG_MAX - 1;
+	return toMSecsSinceEpoch() / 1000;
+}
+
 QDateTime a1time::now(int delta)
 {
 	QDateTime dt = QDateTime::currentDateTime().toUTC().addSecs(delta);
@@ -189,6 +201,15 @@ void a1time::d2i(QByteArray &ba)
 	}
 }
 
+void a1time::d2i(db_cursor &c)
+{
+	ASN1_TIME *n = (ASN1_TIME*)d2i_bytearray( D2I_VOID(d2i_ASN1_TIME), c);
+	if (n) {
+		from_asn1(n);
+		ASN1_TIME_free(n);
+	}
+}
+
 QByteArray a1time::i2d()
 {
 	get();
@@ -12,6 +12,8 @@
 #include <QDateTime>
 #include <openssl/asn1.h>
 
+class db_cursor;
+
 #define SECONDS_PER_DAY (60*60*24)
 
 class a1time : public QDateTime
@@ -35,11 +37,13 @@ class a1time : public QDateTime
 	QString toPrettyGMT() const;
 	QString toPlain() const;
 	QString toSortable() const;
+	qint64 sortKey() const;
 	ASN1_TIME *get();
 	ASN1_TIME *get_utc();
 	static QDateTime now(int delta = 0);
 	QByteArray i2d();
 	void d2i(QByteArray &ba);
+	void d2i(db_cursor &c);
 };
 
 #endif
@@ -12,32 +12,62 @@
 #include <QStringList>
 #include <QDebug>
 #include <QDateTime>
+#include <QFileInfo>
+#include <QMutex>
 #ifdef WIN32
 #include <windows.h>
+#include <io.h>
 #else
 #include <netinet/in.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/syscall.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
 #endif
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
 
 #define XNUM(n) CCHAR(QString::number((n), 16))
+#define READAHEAD_SIZE (1024 * 1024)
+#define JOURNAL_MAGIC 0xcadb1970
+/* Old copies of changed entries. Deleted entries without
+ * DBFLAG_OUTDATED may still be restored and are not reused */
+#define DBFLAG_FREE (DBFLAG_DELETED | DBFLAG_OUTDATED)
+
+QHash<QString, db_state*> db::states;
+static QMutex states_lock;
 
 db::db(QString filename, QFlags<QFile::Permission> perm)
 {
 	name = filename;
+	state = NULL;
+	mapped = NULL;
+	mapped_size = 0;
+	map_failed = false;
+	readahead_offset = 0;
+	readahead_gen = 0;
+	crc_mismatch = false;
+	crc_trusted = false;
 	file.setFileName(filename);
 	bool newFile = !file.exists();
 
 	if (!file.open(QIODevice::ReadWrite)) {
 		fileIOerr("open");
 	} else {
-		first();
+		attach_state();
+		try {
+			recover();
+			first();
+		} catch (errorEx &) {
+			detach_state();
+			throw;
+		}
 		if (newFile)
 			file.setPermissions(perm);
 	}
@@ -45,7 +75,53 @@ db::db(QString filename, QFlags<QFile::Permission> perm)
 
 db::~db()
 {
+	if (state && state->journal && state->journal->owner == this) {
+		qWarning("Uncommitted transaction on '%s' discarded",
+			CCHAR(name));
+		rollback();
+	}
+	unmap();
 	file.close();
+	detach_state();
+}
+
+/* Use the index of other instances or of the last open of the file.
+ * Another process may have changed the file in between */
+void db::attach_state()
+{
+	QFileInfo fi(name);
+	QMutexLocker locker(&states_lock);
+	QString key = fi.absoluteFilePath();
+
+	state = states.value(key);
+	if (!state) {
+		state = new db_state;
+		states[key] = state;
+	}
+	if (state->refs++ == 0 &&
+	    (state->size != fi.size() || state->mtime != fi.lastModified()))
+		state->reset();
+}
+
+/* The file "fname" was replaced or removed: Its index is gone */
+void db::forget_state(const QString &fname)
+{
+	QMutexLocker locker(&states_lock);
+	db_state *s = states.value(QFileInfo(fname).absoluteFilePath());
+
+	if (s)
+		s->reset();
+}
+
+void db::detach_state()
+{
+	QMutexLocker locker(&states_lock);
+
+	if (!state || --state->refs > 0)
+		return;
+	QFileInfo fi(name);
+	state->size = fi.size();
+	state->mtime = fi.lastModified();
 }
 
 void db::fileIOerr(QString s)
@@ -80,6 +156,8 @@ void db::convert_header(db_header_t *h)
 	memcpy(h->name, head.name, NAMELEN);
 }
 
+/* Newer header versions keep the layout and are accepted.
+ * Versions from XDB_HEADVER_CRC on get their checksum verified */
 bool db::verify_magic(void)
 {
 	if (!eof())
@@ -91,11 +169,560 @@ bool db::verify_magic(void)
 
 bool db::eof()
 {
-	return head_offset == file.size();
+	return head_offset == fsize();
+}
+
+/* Build the (type, name) -> offset index of all live entries
+ * and the map of free extents, where new entries may be placed.
+ * This is done once per file, on the first lookup by name.
+ * The current position is preserved. */
+void db::build_index()
+{
+	db_header_t save_head;
+	qint64 save_offset, free_offset = -1, free_len = 0, live = 0;
+
+	if (state->indexed)
+		return;
+
+	state->free_extents.clear();
+	if (index_from_footer()) {
+		state->indexed = true;
+		return;
+	}
+	save_head = head;
+	save_offset = head_offset;
+	state->offsets.clear();
+
+	for (first(0); !eof(); ) {
+		if (!verify_magic())
+			break;
+		int flags = ntohs(head.flags);
+		qint64 len = ntohl(head.len);
+		if ((flags & DBFLAG_FREE) == DBFLAG_FREE) {
+			/* Merge adjacent free entries */
+			if (free_offset + free_len == head_offset &&
+			    free_len + len < 0x7fffffff) {
+				free_len += len;
+			} else {
+				if (free_offset != -1)
+					add_extent(free_offset, free_len);
+				free_offset = head_offset;
+				free_len = len;
+			}
+		} else if (!(flags & DBFLAG_DELETED)) {
+			db_index_key key(ntohs(head.type),
+					QString::fromUtf8(head.name));
+			if (!state->offsets.contains(key))
+				state->offsets[key] = head_offset;
+		}
+		if (!(flags & DBFLAG_FREE))
+			live += len;
+		if (next(0))
+			break;
+	}
+	if (free_offset != -1)
+		add_extent(free_offset, free_len);
+	state->dead = fsize() - live;
+	state->indexed = true;
+
+	head = save_head;
+	head_offset = save_offset;
+	if (head_offset > fsize())
+		head_offset = fsize();
+}
+
+void db::drop_index()
+{
+	state->reset();
+}
+
+void db::add_extent(qint64 offset, qint64 len)
+{
+	state->free_extents.insert(len, offset);
+}
+
+/* Entries of "len" bytes got deleted or outdated (or reused) */
+void db::add_dead(qint64 len)
+{
+	if (state->dead >= 0)
+		state->dead += len;
+}
+
+/* Find the smallest free extent for an entry of "len" bytes.
+ * It must fit exactly or leave room for the header of the
+ * remainder, which stays free. Returns -1 if nothing fits */
+qint64 db::take_extent(qint64 len, qint64 *rest)
+{
+	QMultiMap<qint64, qint64>::iterator i;
+	qint64 offset;
+
+	i = state->free_extents.lowerBound(len);
+	if (i != state->free_extents.end() && i.key() != len &&
+	    i.key() < len + (qint64)sizeof(db_header_t))
+		i = state->free_extents.lowerBound(len + sizeof(db_header_t));
+	if (i == state->free_extents.end())
+		return -1;
+
+	offset = i.value();
+	*rest = i.key() - len;
+	state->free_extents.erase(i);
+	if (*rest)
+		add_extent(offset + len, *rest);
+	return offset;
+}
+
+qint64 db::lookup(enum pki_type type, QString name)
+{
+	build_index();
+	return state->offsets.value(db_index_key(type, name), -1);
+}
+
+void db::seek_header(qint64 offset)
+{
+	head_offset = offset;
+	if (read_at(head_offset, (char*)&head, sizeof head) != sizeof head)
+		fileIOerr("read");
+}
+
+/* The file was written: The read-ahead buffers of all
+ * instances of the file are outdated */
+void db::changed()
+{
+	readahead.clear();
+	if (state)
+		state->generation++;
+}
+
+/* Read from the mapped file or through the read-ahead buffer.
+ * The file is only accessed, if the buffer does not hold the data
+ * or another instance wrote to the file since it was filled */
+qint64 db::read_file(qint64 offset, char *p, qint64 len)
+{
+	qint64 ret;
+	quint64 gen = state ? state->generation : 0;
+
+	if (mapped && offset + len <= mapped_size) {
+		memcpy(p, mapped + offset, len);
+		return len;
+	}
+	if (readahead_gen != gen || offset < readahead_offset ||
+	    offset + len > readahead_offset + readahead.size())
+	{
+		readahead.resize(READAHEAD_SIZE);
+		file.seek(offset);
+		ret = file.read(readahead.data(), READAHEAD_SIZE);
+		if (ret < 0) {
+			readahead.clear();
+			return ret;
+		}
+		readahead.resize(ret);
+		readahead_offset = offset;
+		readahead_gen = gen;
+	}
+	ret = readahead_offset + readahead.size() - offset;
+	if (ret > len)
+		ret = len;
+	if (ret > 0)
+		memcpy(p, readahead.constData() + offset - readahead_offset, ret);
+	return ret < 0 ? 0 : ret;
+}
+
+/* Like read_file(), but sees the writes of a running transaction */
+qint64 db::read_at(qint64 offset, char *p, qint64 len)
+{
+	db_journal *j = staged();
+	QMap<qint64, QByteArray>::const_iterator i;
+	qint64 n, ret = 0;
+
+	if (!j)
+		return read_file(offset, p, len);
+
+	if (offset < j->base) {
+		n = qMin(len, j->base - offset);
+		ret = read_file(offset, p, n);
+		if (ret < n)
+			len = ret;
+	}
+	if (ret < len) {
+		qint64 o = offset + ret - j->base;
+		n = qMin(len - ret, (qint64)j->tail.size() - o);
+		if (n > 0) {
+			memcpy(p + ret, j->tail.constData() + o, n);
+			ret += n;
+		}
+	}
+	if (ret <= 0)
+		return ret;
+
+	/* Items do not overlap: Only the preceding patch may reach
+	 * into the range */
+	i = j->patches.upperBound(offset);
+	if (i != j->patches.constBegin())
+		--i;
+	for (; i != j->patches.constEnd() && i.key() < offset + ret; ++i) {
+		qint64 from = qMax(i.key(), offset);
+		qint64 to = qMin(i.key() + i.value().size(), offset + ret);
+		if (from < to)
+			memcpy(p + (from - offset),
+				i.value().constData() + (from - i.key()),
+				to - from);
+	}
+	return ret;
+}
+
+/* read_at() until "len" bytes are read */
+qint64 db::read_full(qint64 offset, char *p, qint64 len)
+{
+	qint64 ret, done = 0;
+
+	while (done < len) {
+		ret = read_at(offset + done, p + done, len - done);
+		if (ret < 0)
+			return done ? done : ret;
+		if (ret == 0)
+			break;
+		done += ret;
+	}
+	return done;
+}
+
+/* Write to the file or stage the data in the running transaction */
+void db::write_at(qint64 offset, const char *p, qint64 len)
+{
+	db_journal *j = staged();
+
+	if (!j) {
+		changed();
+		file.seek(offset);
+		if (file.write(p, len) != len)
+			fileIOerr("write");
+		return;
+	}
+	if (offset >= j->base) {
+		qint64 o = offset - j->base;
+		if (o + len > j->tail.size())
+			j->tail.resize(o + len);
+		memcpy(j->tail.data() + o, p, len);
+	} else {
+		QByteArray &b = j->patches[offset];
+		if (b.size() < len)
+			b.resize(len);
+		memcpy(b.data(), p, len);
+	}
+}
+
+db_journal *db::staged() const
+{
+	return state ? state->journal : NULL;
+}
+
+/* File size including the items appended by a transaction */
+qint64 db::fsize()
+{
+	db_journal *j = staged();
+
+	return j ? j->base + j->tail.size() : file.size();
+}
+
+static bool plausible_header(const unsigned char *p, qint64 offset,
+				qint64 size)
+{
+	db_header_t h;
+	memcpy(&h, p, sizeof h);
+
+	if (ntohl(h.magic) != XCA_MAGIC || ntohs(h.headver) < 1)
+		return false;
+	if (ntohl(h.len) < sizeof h || offset + ntohl(h.len) > size)
+		return false;
+	/* The free remainder of a reused extent */
+	if (ntohs(h.type) == none)
+		return (ntohs(h.flags) & DBFLAG_FREE) == DBFLAG_FREE;
+	return ntohs(h.type) >= asym_key && ntohs(h.type) <= smartCard;
+}
+
+/* Search garbage for the next item header at or behind "offset".
+ * Large chunks are scanned for the first magic byte by memchr(),
+ * candidates must have a matching magic, a length within the file
+ * and a known type. If nothing is found, the offset of the last
+ * incomplete header is returned, so the caller sees a short read */
+qint64 db::resync(qint64 offset)
+{
+	QByteArray buf;
+	qint64 size = file.size();
+	qint64 hsize = sizeof(db_header_t);
+
+	while (offset + hsize <= size) {
+		const unsigned char *start, *p, *end;
+		qint64 len, resume;
+
+		if (mapped && offset + hsize <= mapped_size) {
+			start = mapped + offset;
+			len = mapped_size - offset;
+		} else {
+			len = size - offset;
+			if (len > READAHEAD_SIZE)
+				len = READAHEAD_SIZE;
+			buf.resize(len);
+			file.seek(offset);
+			len = file.read(buf.data(), len);
+			if (len < hsize)
+				break;
+			start = (const unsigned char *)buf.constData();
+		}
+		end = start + len;
+		resume = offset + len - hsize + 1;
+		for (p = start; (p = (const unsigned char *)
+				memchr(p, XCA_MAGIC >> 24, end - p)); p++)
+		{
+			if (end - p < hsize) {
+				resume = offset + (p - start);
+				break;
+			}
+			if (plausible_header(p, offset + (p - start), size))
+				return offset + (p - start);
+		}
+		offset = resume;
+	}
+	if (offset < size - hsize + 1)
+		offset = size - hsize + 1;
+	return offset < 0 ? 0 : offset;
+}
+
+void db::set_crc(db_header_t *h, const unsigned char *p, int len)
+{
+	uint32_t crc;
+
+	/* Keep header version 1 if the name needs the whole space */
+	if (!memchr(h->name, 0, CRC_OFFSET)) {
+		h->headver = htons(1);
+		return;
+	}
+	crc = htonl(crc32c(0, p, len));
+	h->headver = htons(XDB_HEADVER);
+	memcpy(h->name + CRC_OFFSET, &crc, sizeof crc);
+}
+
+/* A zero checksum was probably overwritten by the name,
+ * written by an older version. Versions before header version 3
+ * also rewrite items of the same size in place and leave a stale
+ * checksum: A mismatch marks their data as unverified.
+ * A mismatch of a version 3 item means corruption */
+void db::verify_crc(const unsigned char *p, qint64 size)
+{
+	uint32_t crc;
+
+	crc_mismatch = false;
+	crc_trusted = ntohs(head.headver) >= XDB_HEADVER;
+	if (ntohs(head.headver) < XDB_HEADVER_CRC)
+		return;
+	memcpy(&crc, head.name + CRC_OFFSET, sizeof crc);
+	if (crc && ntohl(crc) != crc32c(0, p, size))
+		crc_mismatch = true;
+}
+
+/* Offset of a valid index footer at the end of the file or -1 */
+qint64 db::footer()
+{
+	unsigned char trailer[8];
+	uint32_t hi, lo;
+	qint64 offs, size = fsize();
+	db_header_t h;
+
+	if (state->footer_offset != -2)
+		return state->footer_offset;
+
+	state->footer_offset = -1;
+	if (size < (qint64)(sizeof h + sizeof trailer))
+		return -1;
+	if (read_at(size - sizeof trailer, (char*)trailer,
+			sizeof trailer) != sizeof trailer)
+		return -1;
+	memcpy(&hi, trailer, sizeof hi);
+	memcpy(&lo, trailer + sizeof hi, sizeof lo);
+	offs = ((qint64)ntohl(hi) << 32) | ntohl(lo);
+	if (offs < 0 || offs + (qint64)sizeof h > size)
+		return -1;
+	if (read_at(offs, (char*)&h, sizeof h) != sizeof h)
+		return -1;
+	if (ntohl(h.magic) != XCA_MAGIC ||
+	    ntohs(h.headver) != XDB_HEADVER ||
+	    ntohs(h.type) != setting ||
+	    (ntohs(h.flags) & DBFLAG_DELETED) ||
+	    offs + ntohl(h.len) != size ||
+	    strncmp(h.name, XDB_INDEX_NAME, CRC_OFFSET))
+		return -1;
+
+	state->footer_offset = offs;
+	return offs;
+}
+
+bool db::index_from_footer()
+{
+	QByteArray ba;
+	db_header_t h;
+	qint64 size, offs = footer();
+	uint32_t crc;
+
+	if (offs < 0)
+		return false;
+	if (read_at(offs, (char*)&h, sizeof h) != sizeof h)
+		return false;
+	size = ntohl(h.len) - sizeof h;
+	ba.resize(size);
+	file.seek(offs + sizeof h);
+	if (file.read(ba.data(), size) != size)
+		return false;
+	memcpy(&crc, h.name + CRC_OFFSET, sizeof crc);
+	if (ntohl(crc) != crc32c(0, (const unsigned char *)ba.constData(),
+				size))
+		return false;
+	/* Older footers lack the free extents: Walk the file */
+	if (ntohs(h.version) < XDB_INDEX_VER)
+		return false;
+	state->dead = -1;
+
+	state->offsets.clear();
+	state->free_extents.clear();
+	try {
+		db_cursor c(ba);
+		uint32_t count = intFromData(c);
+		for (uint32_t i = 0; i < count; i++) {
+			qint64 o = (qint64)intFromData(c) << 32;
+			o |= intFromData(c);
+			int type = intFromData(c);
+			db_index_key key(type, stringFromData(c));
+			if (!state->offsets.contains(key))
+				state->offsets[key] = o;
+		}
+		count = intFromData(c);
+		for (uint32_t i = 0; i < count; i++) {
+			qint64 o = (qint64)intFromData(c) << 32;
+			o |= intFromData(c);
+			add_extent(o, intFromData(c));
+		}
+		state->dead = (qint64)intFromData(c) << 32;
+		state->dead |= intFromData(c);
+	} catch (errorEx &) {
+		state->offsets.clear();
+		state->free_extents.clear();
+		state->dead = -1;
+		return false;
+	}
+	return true;
+}
+
+/* Invalidate the index footer before the file gets modified */
+void db::drop_footer()
+{
+	db_header_t h;
+	qint64 offs = footer();
+
+	if (offs < 0)
+		return;
+	state->footer_offset = -1;
+	state->offsets.remove(db_index_key(setting, XDB_INDEX_NAME));
+	if (read_at(offs, (char*)&h, sizeof h) != sizeof h)
+		return;
+	h.flags |= htons(DBFLAG_FREE);
+	write_at(offs, (char*)&h, sizeof h);
+	add_dead(ntohl(h.len));
+	if (state->indexed)
+		add_extent(offs, ntohl(h.len));
+}
+
+/* Write the index footer at the current position of "f".
+ * The free extents and dead bytes are those of the shared
+ * state or none */
+bool db::write_footer(QFile &f, QByteArray index, int count, bool extents)
+{
+	db_header_t h;
+	qint64 offs = f.pos();
+	QByteArray ba = intToData(count) + index;
+	QMultiMap<qint64, qint64>::const_iterator i;
+
+	if (extents) {
+		ba += intToData(state->free_extents.count());
+		for (i = state->free_extents.constBegin();
+		     i != state->free_extents.constEnd(); ++i) {
+			ba += intToData(i.value() >> 32);
+			ba += intToData(i.value() & 0xffffffff);
+			ba += intToData(i.key());
+		}
+		ba += intToData(state->dead >> 32);
+		ba += intToData(state->dead & 0xffffffff);
+	} else {
+		ba += intToData(0);
+		ba += intToData(0);
+		ba += intToData(0);
+	}
+	ba += intToData(offs >> 32);
+	ba += intToData(offs & 0xffffffff);
+
+	init_header(&h, XDB_INDEX_VER, ba.size(), setting, XDB_INDEX_NAME);
+	set_crc(&h, (const unsigned char *)ba.constData(), ba.size());
+	if (f.write((char*)&h, sizeof h) != sizeof h)
+		return false;
+	return f.write(ba) == ba.size();
+}
+
+/* Append a new index footer, if the file has none. Every change
+ * drops the footer, this restores it once, e.g. on closing */
+void db::save_index()
+{
+	QByteArray index;
+	QHash<db_index_key, qint64>::const_iterator i;
+	int count = 0;
+
+	if (staged() || footer() >= 0)
+		return;
+	build_index();
+	state->offsets.remove(db_index_key(setting, XDB_INDEX_NAME));
+	for (i = state->offsets.constBegin(); i != state->offsets.constEnd(); ++i) {
+		index += intToData(i.value() >> 32);
+		index += intToData(i.value() & 0xffffffff);
+		index += intToData(i.key().first);
+		index += stringToData(i.key().second);
+		count++;
+	}
+	changed();
+	file.seek(file.size());
+	qint64 offs = file.pos();
+	if (!write_footer(file, index, count)) {
+		file.resize(offs);
+		fileIOerr("write");
+	}
+	state->offsets[db_index_key(setting, XDB_INDEX_NAME)] = offs;
+	state->footer_offset = -2;
 }
 
 int db::find(enum pki_type type, QString name)
 {
+	if (!name.isEmpty()) {
+		qint64 offs = lookup(type, name);
+		if (offs == -1) {
+			head_offset = fsize();
+			return 1;
+		}
+		if (offs >= head_offset) {
+			db_header_t save_head = head;
+			qint64 save_offset = head_offset;
+
+			if (offs + (qint64)sizeof head <= fsize()) {
+				seek_header(offs);
+				if (verify_magic() && ntohs(head.type) == type &&
+				    !(ntohs(head.flags) & DBFLAG_DELETED) &&
+				    QString::fromUtf8(head.name) == name)
+					return 0;
+			}
+			/* Stale footer index: Walk the file instead */
+			head = save_head;
+			head_offset = save_offset;
+			drop_index();
+			state->footer_offset = -1;
+			return find(type, name);
+		}
+		/* Behind the current position: search forward */
+	}
 	while (!eof()) {
 		if (ntohs(head.type) == type) {
 			if (name.isEmpty()) { /* only compare type */
@@ -117,12 +744,11 @@ void db::first(int flag)
 	int ret;
 	memset(&head, 0, sizeof(db_header_t) );
 	head_offset = 0;
-	file.seek(0);
-	ret = file.read((char*)&head, sizeof(db_header_t) );
+	ret = read_at(0, (char*)&head, sizeof(db_header_t) );
 	if (ret < 0 )
 		fileIOerr("read");
 	if (ret==0) {
-		head_offset = file.size();
+		head_offset = fsize();
 		return;
 	}
 	if (!verify_magic())
@@ -141,15 +767,14 @@ int db::next(int flag)
 		return 1;
 
 	head_offset += ntohl(head.len);
-	if (head_offset >= file.size()) {
-		head_offset = file.size();
+	if (head_offset >= fsize()) {
+		head_offset = fsize();
 		return 1;
 	}
 	while (1) {
-		file.seek(head_offset);
-		ret = file.read((char*)&head, sizeof head);
+		ret = read_at(head_offset, (char*)&head, sizeof head);
 		if (ret==0) {
-			head_offset = file.size();
+			head_offset = fsize();
 			break;
 		}
 		if (ret < 0) {
@@ -166,16 +791,20 @@ int db::next(int flag)
 			}
 			qWarning("next(): Truncating 0x%s garbage bytes @ 0x%s",
 				XNUM(ret), XNUM(head_offset));
-			if (backup())
+			if (!staged() && backup()) {
+				unmap();
+				changed();
+				state->dead = -1;
 				file.resize(head_offset);
-			head_offset = file.size();
+			}
+			head_offset = fsize();
 			return -1;
 		}
 		qint64 hlen = ntohl(head.len);
 		if (!verify_magic()) {
 			if (garbage == -1)
 				garbage = head_offset;
-			head_offset += 1;
+			head_offset = resync(head_offset + 1);
 			continue;
 		} else {
 			if (garbage != -1) {
@@ -184,18 +813,17 @@ int db::next(int flag)
 					XNUM(garbage));
 			}
 			garbage = -1;
-			if (file.size() < head_offset + hlen) {
+			if (fsize() < head_offset + hlen) {
 				qWarning("next(): Short item (%s of %s) at 0x%s",
 					XNUM(ntohl(head.len)),
-					XNUM(file.size() - head_offset),
+					XNUM(fsize() - head_offset),
 					XNUM(head_offset));
 				garbage = head_offset;
 				/* invalidate the header */
 				qWarning("Invalidate short item @  0x%s\n",
 					XNUM(head_offset));
-				file.seek(head_offset);
 				char inval = 0xcb; // 0xca +1
-				file.write(&inval, 1);
+				write_at(head_offset, &inval, 1);
 				head_offset += 4;
 				continue;
 			}
@@ -216,27 +844,27 @@ int db::next(int flag)
 
 void db::rename(enum pki_type type, QString name, QString n)
 {
-	qint64 ret;
-
-	first();
-	if (find(type, n) == 0) {
+	if (lookup(type, n) != -1) {
 		throw errorEx(QObject::tr("DB: Rename: '%1' already in use").arg(n));
 	}
 	first();
 	if (find(type, name) != 0) {
 		throw errorEx(QObject::tr("DB: Entry to rename not found: %1").arg(name));
 	}
+	char crc[4];
+	memcpy(crc, head.name + CRC_OFFSET, sizeof crc);
 	strncpy(head.name, n.toUtf8(), NAMELEN);
 	head.name[NAMELEN-1] = '\0';
-	file.seek(head_offset);
-	ret = file.write((char*)&head, sizeof(head));
-	if (ret < 0) {
-		fileIOerr("write");
-	}
-	if (ret != sizeof head) {
-		throw errorEx(QObject::tr("DB: Write error %1 - %2"
-				).arg(ret).arg(sizeof(head)));
+	if (ntohs(head.headver) >= XDB_HEADVER_CRC) {
+		if (memchr(head.name, 0, CRC_OFFSET))
+			memcpy(head.name + CRC_OFFSET, crc, sizeof crc);
+		else
+			head.headver = htons(1);
 	}
+	drop_footer();
+	write_at(head_offset, (char*)&head, sizeof(head));
+	state->offsets.remove(db_index_key(type, name));
+	state->offsets[db_index_key(type, QString::fromUtf8(head.name))] = head_offset;
 }
 
 QString db::uniq_name(QString s, QList<enum pki_type> types)
@@ -256,8 +884,7 @@ QString db::uniq_name(QString s, QList<enum pki_type> types)
 	for (i=1, myname = s; ; i++) {
 		bool found = false;
 		foreach (enum pki_type type, types) {
-			first();
-			if (find(type, myname) == 0) {
+			if (lookup(type, myname) != -1) {
 				myname = s + QString("_%1").arg(i);
 				found = true;
 				break;
@@ -273,21 +900,62 @@ int db::add(const unsigned char *p, int len, int ver, enum pki_type type,
 		QString name)
 {
 	db_header_t head;
+	qint64 offset = -1, rest = 0;
 
 	init_header(&head, ver, len, type, name);
-	file.seek(file.size());
-
-	if (file.write((char*)&head, sizeof head) != sizeof head) {
-		fileIOerr("write");
-		return -1;
+	set_crc(&head, p, len);
+	drop_footer();
+	if (state->indexed)
+		offset = take_extent(sizeof head + len, &rest);
+	if (offset != -1 && !free_at(offset)) {
+		/* The file changed behind the index */
+		qWarning("add(): Stale free extent at 0x%s", XNUM(offset));
+		drop_index();
+		offset = -1;
 	}
-	if (file.write((char*)p, len) != len) {
-		fileIOerr("write");
-		return -1;
+	if (offset == -1) {
+		offset = fsize();
+		write_at(offset, (char*)&head, sizeof head);
+		write_at(offset + sizeof head, (const char*)p, len);
+	} else {
+		add_dead(-(qint64)(sizeof head + len));
+		/* The header comes last: Until then the free header of
+		 * the whole extent covers the payload and the header
+		 * of the remainder */
+		write_at(offset + sizeof head, (const char*)p, len);
+		if (rest) {
+			db_header_t free_head;
+			init_header(&free_head, 0, rest - sizeof free_head,
+					none, QString());
+			free_head.flags = htons(DBFLAG_FREE);
+			write_at(offset + sizeof head + len,
+				(char*)&free_head, sizeof free_head);
+		}
+		write_at(offset, (char*)&head, sizeof head);
+	}
+	if (state->indexed) {
+		db_index_key key(type, QString::fromUtf8(head.name));
+		if (!state->offsets.contains(key))
+			state->offsets[key] = offset;
 	}
 	return 0;
 }
 
+/* Whether a free entry starts at "offset" */
+bool db::free_at(qint64 offset)
+{
+	db_header_t h;
+
+	if (read_full(offset, (char*)&h, sizeof h) != sizeof h)
+		return false;
+	return ntohl(h.magic) == XCA_MAGIC &&
+		(ntohs(h.flags) & DBFLAG_FREE) == DBFLAG_FREE;
+}
+
+/* Replacing an entry writes the new one to another place first
+ * and frees the old one afterwards. A crash leaves either the old
+ * or the new entry behind, the first one in the file wins.
+ * Only a running transaction of the caller gets the writes journaled */
 int db::set(const unsigned char *p, int len, int ver, enum pki_type type,
 		                QString name)
 {
@@ -295,40 +963,21 @@ int db::set(const unsigned char *p, int len, int ver, enum pki_type type,
 
 	first();
 	ret = find(type, name);
-	if (ret != 0) {
+	if (ret != 0)
 		return add(p, len, ver, type, name);
-	} else {
-		file.seek(head_offset);
-		if (len != (int)(ntohl(head.len) - sizeof(db_header_t))) {
-			int flags;
-			flags = head.flags;
-			head.flags |= htons(DBFLAG_DELETED | DBFLAG_OUTDATED);
-
-			if (file.write((char*)&head, sizeof head) !=
-					sizeof head)
-			{
-				fileIOerr("write");
-				return -1;
-			}
-			if (add(p, len, ver, type, name) < 0) {
-				file.seek(head_offset);
-				head.flags = flags;
-				ret = file.write((char*)&head, sizeof head);
-				if (ret != sizeof head)
-					fileIOerr("write");
-			}
-			return 0;
-		}
-		head.version = htons(ver);
-		if (file.write((char*)&head, sizeof head) != sizeof head) {
-			fileIOerr("write");
-			return -1;
-		}
-		if (file.write((char*)p, len) != len) {
-			fileIOerr("write");
-			return -1;
-		}
-	}
+
+	db_header_t old = head;
+	qint64 old_offset = head_offset;
+
+	drop_footer();
+	/* The new slot must not be the old entry */
+	state->offsets.remove(db_index_key(type, name));
+	add(p, len, ver, type, name);
+	old.flags |= htons(DBFLAG_FREE);
+	write_at(old_offset, (char*)&old, sizeof old);
+	add_dead(ntohl(old.len));
+	if (state->indexed)
+		add_extent(old_offset, ntohl(old.len));
 	return 0;
 }
 
@@ -343,9 +992,15 @@ unsigned char *db::load(db_header_t *u_header)
 		return NULL;
 	size = ntohl(head.len) - sizeof(db_header_t);
 	data = (unsigned char *)malloc(size);
-	file.seek(head_offset + sizeof(db_header_t));
-	ret = file.read((char*)data, size);
+	if (staged()) {
+		ret = read_full(head_offset + sizeof(db_header_t),
+				(char*)data, size);
+	} else {
+		file.seek(head_offset + sizeof(db_header_t));
+		ret = file.read((char*)data, size);
+	}
 	if (ret == (qint64)size) {
+		verify_crc(data, size);
 		if (u_header)
 			convert_header(u_header);
 		return data;
@@ -357,6 +1012,62 @@ unsigned char *db::load(db_header_t *u_header)
 	}
 }
 
+/* Like load(), but the returned data is owned by the database.
+ * It points into the memory mapped file, if possible, and stays
+ * valid until the next call or the database is closed */
+const unsigned char *db::view(db_header_t *u_header)
+{
+	qint64 size, ret;
+
+	if (eof())
+		return NULL;
+	size = ntohl(head.len) - sizeof(db_header_t);
+
+	if (!mapped && !map_failed) {
+		mapped = file.map(0, file.size());
+		if (mapped)
+			mapped_size = file.size();
+		else
+			map_failed = true;
+	}
+	if (mapped && !staged() &&
+	    head_offset + ntohl(head.len) <= mapped_size)
+	{
+		const unsigned char *p = mapped + head_offset +
+						sizeof(db_header_t);
+		verify_crc(p, size);
+		if (u_header)
+			convert_header(u_header);
+		return p;
+	}
+	/* Not mapped or appended after mapping */
+	viewbuf.resize(size);
+	if (size > READAHEAD_SIZE && !staged()) {
+		file.seek(head_offset + sizeof(db_header_t));
+		ret = file.read(viewbuf.data(), size);
+	} else {
+		ret = read_full(head_offset + sizeof(db_header_t),
+				viewbuf.data(), size);
+	}
+	if (ret != size) {
+		if (ret < 0)
+			fileIOerr("read");
+		return NULL;
+	}
+	verify_crc((const unsigned char *)viewbuf.constData(), size);
+	if (u_header)
+		convert_header(u_header);
+	return (const unsigned char *)viewbuf.constData();
+}
+
+void db::unmap()
+{
+	if (mapped)
+		file.unmap(mapped);
+	mapped = NULL;
+	mapped_size = 0;
+}
+
 bool db::get_header(db_header_t *u_header)
 {
 	if (eof())
@@ -370,23 +1081,87 @@ int db::erase(void)
 	if (eof())
 		return -1;
 
+	if (!(ntohs(head.flags) & DBFLAG_FREE))
+		add_dead(ntohl(head.len));
 	head.flags |= htons(DBFLAG_DELETED);
 
-	file.seek(head_offset);
-	if (file.write((char*)&head, sizeof(db_header_t)) != sizeof(db_header_t)) {
-		fileIOerr("write");
-		return -1;
+	drop_footer();
+	write_at(head_offset, (char*)&head, sizeof(db_header_t));
+	db_index_key key(ntohs(head.type), QString::fromUtf8(head.name));
+	if (state->offsets.value(key, -1) == head_offset)
+		state->offsets.remove(key);
+	return 0;
+}
+
+/* Percentage of the file occupied by entries with one of
+ * "flags" set or by garbage. Deleted or outdated entries are
+ * counted by the index, other flags need a walk through the file */
+int db::dead_ratio(int flags)
+{
+	qint64 live = 0, size = fsize();
+
+	if (size == 0)
+		return 0;
+	if (flags == DBFLAG_FREE) {
+		build_index();
+		if (state->dead >= 0)
+			return state->dead * 100 / size;
+	}
+	for (first(0); !eof(); ) {
+		if (!verify_magic())
+			break;
+		if (!(ntohs(head.flags) & flags))
+			live += ntohl(head.len);
+		if (next(0))
+			break;
 	}
+	return (size - live) * 100 / size;
+}
+
+/* Copy "len" bytes from the current position of "in" to "out"
+ * inside the kernel. Returns the number of bytes copied, the
+ * caller copies the rest */
+static qint64 copy_range(QFile &in, QFile &out, qint64 len)
+{
+#if defined(__linux__) && defined(SYS_copy_file_range)
+	loff_t off_in = in.pos(), off_out = out.pos();
+	qint64 ret, done = 0;
+
+	if (!out.flush())
+		return 0;
+	while (done < len) {
+		ret = syscall(SYS_copy_file_range, in.handle(), &off_in,
+				out.handle(), &off_out, len - done, 0);
+		if (ret <= 0)
+			break;
+		done += ret;
+	}
+	if (done) {
+		in.seek(in.pos() + done);
+		out.seek(out.pos() + done);
+	}
+	return done;
+#else
+	(void)in;
+	(void)out;
+	(void)len;
 	return 0;
+#endif
 }
 
-int db::shrink(int flags)
+int db::shrink(int flags, QAtomicInt *progress)
 {
-	qint64 ret, garbage = -1;
-	uint32_t offs;
-	char buf[BUFSIZ];
+	qint64 ret, start, size, garbage = -1;
+	uint32_t offs, crc;
+	QByteArray buffer(READAHEAD_SIZE, 0);
+	char *buf = buffer.data();
 	QFile new_file;
-	int result = 0;
+	QByteArray index;
+	int result = 0, count = 0;
+
+	/* The file must not change under a transaction */
+	if (staged())
+		return 2;
 
 	new_file.setFileName(name + "{shrink}");
 	if (!new_file.open(QIODevice::ReadWrite)) {
@@ -394,8 +1169,11 @@ int db::shrink(int flags)
 		return 1;
 	}
 	file.reset();
+	size = file.size();
 
 	while ((ret = file.read((char*)&head, sizeof head)) > 0) {
+		if (progress && size)
+			progress->fetchAndStoreRelaxed(file.pos() * 100 / size);
 		if (ret < (qint64)sizeof head) {
 			qWarning("shrink(): Short read: 0x%s instead of 0x%s",
 				XNUM(ret), XNUM(sizeof head));
@@ -403,9 +1181,10 @@ int db::shrink(int flags)
 			break;
 		}
 		if (!verify_magic()) {
-			file.seek(file.pos() - sizeof(head) +1);
+			qint64 bad = file.pos() - sizeof(head);
 			if (garbage == -1)
-				garbage = file.pos() -1;
+				garbage = bad;
+			file.seek(resync(bad +1));
 			result = 1;
 			continue;
 		}
@@ -424,20 +1203,36 @@ int db::shrink(int flags)
 			continue;
 		}
 		if (head_offset + file.pos() > file.size()) {
-			file.seek(file.pos() - sizeof(head) +4);
+			qint64 bad = file.pos() - sizeof(head);
 			if (garbage == -1)
-				garbage = file.pos() -4;
+				garbage = bad;
+			file.seek(resync(bad +4));
+			continue;
+		}
+		/* The index footer gets rewritten below */
+		if (ntohs(head.type) == setting &&
+		    !strncmp(head.name, XDB_INDEX_NAME, CRC_OFFSET)) {
+			file.seek(head_offset + file.pos());
 			continue;
 		}
 
+		start = new_file.pos();
 		ret = new_file.write((char*)&head, sizeof(head));
 		if (ret != sizeof(head)) {
 			result = 2;
 			break;
 		}
 		offs = head_offset;
+		crc = 0;
+		/* Old entries get a checksum below, version 2
+		 * entries a fresh one: It may be stale */
+		bool upgrade = ntohs(head.headver) < XDB_HEADVER &&
+				memchr(head.name, 0, CRC_OFFSET);
+		if (!upgrade)
+			offs -= copy_range(file, new_file, offs);
 		while (offs) {
-			ret = file.read((char*)buf, (offs > BUFSIZ) ? BUFSIZ : offs);
+			ret = file.read((char*)buf, (offs > READAHEAD_SIZE) ?
+						READAHEAD_SIZE : offs);
 			if (ret <= 0) {
 				result = 3;
 				break;
@@ -446,14 +1241,38 @@ int db::shrink(int flags)
 				result = 4;
 				break;
 			}
+			if (upgrade)
+				crc = crc32c(crc, (unsigned char*)buf, ret);
 			offs -= ret;
 		}
 		if (offs)
 			break;
 
+		if (upgrade) {
+			crc = htonl(crc);
+			head.headver = htons(XDB_HEADVER);
+			memcpy(head.name + CRC_OFFSET, &crc, sizeof crc);
+			new_file.seek(start);
+			if (new_file.write((char*)&head, sizeof(head)) !=
+					sizeof(head)) {
+				result = 2;
+				break;
+			}
+			new_file.seek(new_file.size());
+		}
+		index += intToData(start >> 32);
+		index += intToData(start & 0xffffffff);
+		index += intToData(ntohs(head.type));
+		index += stringToData(QString::fromUtf8(head.name));
+		count++;
 	}
+	if (result < 2 && !write_footer(new_file, index, count, false))
+		result = 2;
 	new_file.close();
+	unmap();
+	changed();
 	file.close();
+	drop_index();
 	QString backup, orig;
 
 	switch (result) {
@@ -523,6 +1342,10 @@ bool db::backup()
 // Move "new_file" to this database
 int db::mv(QFile &new_file)
 {
+	/* Neither index fits the file afterwards */
+	drop_index();
+	forget_state(new_file.fileName());
+
 #ifdef WIN32
 	// here we try to reimplement the simple "mv" command on unix
 	// atomic renaming fails on WIN32 platforms and
@@ -553,20 +1376,266 @@ int db::mv(QFile &new_file)
 #endif
 }
 
+/* Start staging all writes to this file, also those of other
+ * db instances. Transactions can not be nested */
+void db::begin()
+{
+	if (state->journal)
+		throw errorEx(QObject::tr("DB: Transaction on '%1' already running").arg(name));
+	state->journal = new db_journal;
+	state->journal->owner = this;
+	state->journal->base = file.size();
+}
+
+/* Write the staged data as one journal, sync it and apply it to
+ * the file. An interrupted commit is completed by recover() */
+void db::commit()
+{
+	db_journal *j = staged();
+	QMap<qint64, QByteArray>::const_iterator i;
+	QByteArray ba;
+	QFile jf;
+	int count = 0;
+
+	if (!j || j->owner != this)
+		return;
+	state->journal = NULL;
+
+	/* Something else changed the file meanwhile: The staged
+	 * offsets do not fit anymore, nothing gets written */
+	if (file.size() != j->base) {
+		delete j;
+		drop_index();
+		throw errorEx(QObject::tr("DB: The file '%1' was changed during a transaction").arg(name));
+	}
+	for (i = j->patches.constBegin(); i != j->patches.constEnd(); ++i) {
+		ba += intToData(i.key() >> 32);
+		ba += intToData(i.key() & 0xffffffff);
+		ba += intToData(i.value().size());
+		ba += i.value();
+		count++;
+	}
+	if (j->tail.size() > 0) {
+		qint64 offs = file.size();
+		ba += intToData(offs >> 32);
+		ba += intToData(offs & 0xffffffff);
+		ba += intToData(j->tail.size());
+		ba += j->tail;
+		count++;
+	}
+	delete j;
+	if (!count)
+		return;
+
+	ba.prepend(intToData(count));
+	ba.prepend(intToData(JOURNAL_MAGIC));
+	ba += intToData(crc32c(0, (const unsigned char *)ba.constData(),
+				ba.size()));
+
+	jf.setFileName(name + "{journal}");
+	if (!jf.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		fileIOerr("open");
+	if (jf.write(ba) != ba.size()) {
+		jf.remove();
+		fileIOerr("write");
+	}
+	sync(jf);
+	jf.close();
+	sync_dir(name);
+
+	/* On failure the journal stays for recover() */
+	try {
+		if (!replay(ba))
+			throw errorEx(QObject::tr("DB: Applying the journal of '%1' failed").arg(name));
+	} catch (errorEx &) {
+		drop_index();
+		throw;
+	}
+	sync(file);
+	jf.remove();
+	sync_dir(name);
+}
+
+/* Discard all staged writes */
+void db::rollback()
+{
+	db_journal *j = staged();
+
+	if (!j || j->owner != this)
+		return;
+	state->journal = NULL;
+	delete j;
+	drop_index();
+}
+
+/* Apply a journal written by commit(). Nothing is written and
+ * false returned, if it is incomplete. Write errors throw */
+bool db::replay(const QByteArray &ba)
+{
+	uint32_t crc;
+	int size = ba.size() - sizeof crc;
+	QList<QPair<qint64, QByteArray> > writes;
+
+	if (size < 8)
+		return false;
+	memcpy(&crc, ba.constData() + size, sizeof crc);
+	if (ntohl(crc) != crc32c(0, (const unsigned char *)ba.constData(),
+				size))
+		return false;
+
+	db_cursor c((const unsigned char *)ba.constData(), size);
+	try {
+		if (intFromData(c) != JOURNAL_MAGIC)
+			return false;
+		uint32_t count = intFromData(c);
+		for (uint32_t n = 0; n < count; n++) {
+			qint64 offs = (qint64)intFromData(c) << 32;
+			offs |= intFromData(c);
+			uint32_t len = intFromData(c);
+			if ((int)len > c.left())
+				return false;
+			writes << qMakePair(offs, QByteArray::fromRawData(
+					(const char *)c.pos(), len));
+			c.skip(len);
+		}
+	} catch (errorEx &) {
+		return false;
+	}
+	for (int i = 0; i < writes.size(); i++)
+		write_at(writes[i].first, writes[i].second.constData(),
+			writes[i].second.size());
+	return true;
+}
+
+/* Complete the commit() of a transaction, that was interrupted */
+void db::recover()
+{
+	QFile jf(name + "{journal}");
+
+	if (!jf.exists())
+		return;
+	if (jf.open(QIODevice::ReadOnly)) {
+		QByteArray ba = jf.readAll();
+		jf.close();
+		if (replay(ba)) {
+			sync(file);
+			drop_index();
+			qWarning("Journal of '%s' recovered", CCHAR(name));
+		} else {
+			qWarning("Incomplete journal of '%s' discarded",
+				CCHAR(name));
+		}
+	}
+	jf.remove();
+	sync_dir(name);
+}
+
+void db::sync(QFile &f)
+{
+	f.flush();
+#ifdef WIN32
+	_commit(f.handle());
+#else
+	fsync(f.handle());
+#endif
+}
+
+/* Make the creation or removal of a file next to "fname" durable */
+void db::sync_dir(const QString &fname)
+{
+#ifdef WIN32
+	(void)fname;
+#else
+	QString dir = QFileInfo(fname).absolutePath();
+	int fd = ::open(QString2filename(dir), O_RDONLY);
+
+	if (fd == -1)
+		return;
+	fsync(fd);
+	::close(fd);
+#endif
+}
+
+class crc32c_table
+{
+    public:
+	uint32_t t[256];
+	crc32c_table()
+	{
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? (c >> 1) ^ 0x82f63b78 : c >> 1;
+			t[i] = c;
+		}
+	}
+};
+
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char *p, size_t len)
+{
+	/* Initialized once, thread safe: The compaction thread
+	 * and the GUI thread may get here at the same time */
+	static const crc32c_table table;
+
+	while (len--)
+		crc = table.t[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char *p, size_t len)
+{
+	uint64_t c = crc;
+	while (len >= 8) {
+		uint64_t v;
+		memcpy(&v, p, sizeof v);
+		c = _mm_crc32_u64(c, v);
+		p += 8;
+		len -= 8;
+	}
+	crc = c;
+	while (len--)
+		crc = _mm_crc32_u8(crc, *p++);
+	return crc;
+}
+#endif
+
+/* CRC32C (Castagnoli), using the SSE4.2 crc32 instruction if available */
+uint32_t db::crc32c(uint32_t crc, const unsigned char *p, size_t len)
+{
+	crc = ~crc;
+#if defined(__GNUC__) && defined(__x86_64__)
+	if (__builtin_cpu_supports("sse4.2"))
+		return ~crc32c_hw(crc, p, len);
+#endif
+	return ~crc32c_sw(crc, p, len);
+}
+
 QByteArray db::intToData(uint32_t val)
 {
 	uint32_t v = htonl(val);
 	return QByteArray((char*)&v, sizeof(uint32_t));
 }
 
+/* The QByteArray versions parse through a cursor and
+ * drop the parsed part, like the cursor skips it */
 uint32_t db::intFromData(QByteArray &ba)
+{
+	db_cursor c(ba);
+	uint32_t ret = intFromData(c);
+	ba = ba.mid(ba.size() - c.left());
+	return ret;
+}
+
+uint32_t db::intFromData(db_cursor &c)
 {
 	uint32_t ret;
-	if ((unsigned)(ba.count()) < sizeof(uint32_t)) {
+	if ((unsigned)(c.left()) < sizeof(uint32_t)) {
 		throw errorEx(QObject::tr("Out of data"));
 	}
-	memcpy(&ret, ba.constData(), sizeof(uint32_t));
-	ba = ba.mid(sizeof(uint32_t));
+	memcpy(&ret, c.pos(), sizeof(uint32_t));
+	c.skip(sizeof(uint32_t));
 	return ntohl(ret);
 }
 
@@ -578,13 +1647,21 @@ QByteArray db::boolToData(bool val)
 
 bool db::boolFromData(QByteArray &ba)
 {
-	unsigned char c;
-	if (ba.count() < 1)
+	db_cursor c(ba);
+	bool ret = boolFromData(c);
+	ba = ba.mid(ba.size() - c.left());
+	return ret;
+}
+
+bool db::boolFromData(db_cursor &c)
+{
+	unsigned char c0;
+	if (c.left() < 1)
 		throw errorEx(QObject::tr("Out of data"));
 
-	c = ba.constData()[0];
-	ba = ba.mid(1);
-	return c ? true : false;
+	c0 = c.pos()[0];
+	c.skip(1);
+	return c0 ? true : false;
 }
 
 QByteArray db::stringToData(const QString val)
@@ -600,12 +1677,29 @@ QByteArray db::stringToData(const QString val)
 
 QString db::stringFromData(QByteArray &ba)
 {
-	int idx = ba.indexOf('\0');
+	db_cursor c(ba);
+	QString ret = stringFromData(c);
+	ba = ba.mid(ba.size() - c.left());
+	return ret;
+}
 
-	if (idx == -1)
+QString db::stringFromData(db_cursor &c)
+{
+	const unsigned char *end;
+
+	end = (const unsigned char *)memchr(c.pos(), 0, c.left());
+	if (!end)
 		throw errorEx(QObject::tr("Error finding endmarker of string"));
 
-	QString ret = QString::fromUtf8(ba.constData(), idx);
-	ba = ba.mid(idx+1);
+	int idx = end - c.pos();
+	QString ret = QString::fromUtf8((const char *)c.pos(), idx);
+	c.skip(idx+1);
 	return ret;
 }
+
+void db_cursor::skip(int n)
+{
+	if (n < 0 || n > left())
+		throw errorEx(QObject::tr("Out of data"));
+	offs += n;
+}
@@ -14,6 +14,12 @@
 #include <fcntl.h>
 #include <QString>
 #include <QFile>
+#include <QByteArray>
+#include <QHash>
+#include <QPair>
+#include <QMap>
+#include <QAtomicInt>
+#include <QDateTime>
 
 #define XCA_MAGIC 0xcadb1969
 #define NAMELEN 80
@@ -22,6 +28,22 @@
 #define DBFLAG_DELETED  0x1
 #define DBFLAG_OUTDATED 0x2
 
+/* Header version 2 stores the CRC32C of the item data in the
+ * last 4 bytes of the name. Older versions just see a shorter name,
+ * but may leave a stale checksum behind: See db::verify_crc().
+ * Version 3 is only written by code, that never rewrites an item
+ * in place. Its checksum is authoritative */
+#define XDB_HEADVER_CRC 2
+#define XDB_HEADVER 3
+#define CRC_OFFSET (NAMELEN - 4)
+
+/* Setting written by shrink() as last item: Offset, type and name
+ * of all items, offset and length of the free extents (version 2),
+ * the number of dead bytes (version 3),
+ * followed by its own offset as last 8 bytes */
+#define XDB_INDEX_NAME "xdb_index"
+#define XDB_INDEX_VER 3
+
 enum pki_type {
 	none,
 	asym_key,
@@ -43,6 +65,95 @@ typedef struct {
 	char name[NAMELEN];	/* name of the entry */
 } db_header_t ;
 
+/* Read cursor over the data of a database item.
+ * Parsing moves the offset instead of copying the remaining data */
+class db_cursor
+{
+    private:
+	const unsigned char *data;
+	int size;
+	int offs;
+
+    public:
+	db_cursor(const unsigned char *p, int len)
+	{
+		data = p;
+		size = len;
+		offs = 0;
+	}
+	db_cursor(const QByteArray &ba)
+	{
+		data = (const unsigned char *)ba.constData();
+		size = ba.size();
+		offs = 0;
+	}
+	const unsigned char *pos() const
+	{
+		return data + offs;
+	}
+	int left() const
+	{
+		return size - offs;
+	}
+	QByteArray rest() const
+	{
+		return QByteArray((const char *)pos(), left());
+	}
+	void skip(int n);
+};
+
+/* (type, name) -> file offset of the live entry */
+typedef QPair<int, QString> db_index_key;
+
+/* Writes staged by a transaction. They are shared by all db
+ * instances of the file and applied to it by commit() */
+class db_journal
+{
+    public:
+	const void *owner;
+	qint64 base;		/* file size at begin() */
+	QByteArray tail;	/* appended items */
+	QMap<qint64, QByteArray> patches; /* in-place writes */
+};
+
+/* Index of one file, shared by all its db instances. It is kept
+ * while the file is closed and dropped on the next open, if the
+ * size or modification time changed meanwhile */
+class db_state
+{
+    public:
+	int refs;
+	qint64 size;
+	QDateTime mtime;
+	bool indexed;
+	QHash<db_index_key, qint64> offsets;
+	QMultiMap<qint64, qint64> free_extents; /* length -> offset */
+	qint64 footer_offset;
+	db_journal *journal;	/* running transaction */
+	quint64 generation;	/* bumped by every write to the file */
+	qint64 dead;	/* bytes of deleted or outdated entries, -1: unknown */
+
+	db_state()
+	{
+		journal = NULL;
+		generation = 0;
+		refs = 0;
+		size = -1;
+		indexed = false;
+		footer_offset = -2;
+		dead = -1;
+	}
+	void reset()
+	{
+		offsets.clear();
+		free_extents.clear();
+		indexed = false;
+		footer_offset = -2;
+		dead = -1;
+		generation++;
+	}
+};
+
 class db
 {
     private:
@@ -51,6 +162,17 @@ class db
 	QString errstr;
 	int dberrno;
 	db_header_t head;
+	db_state *state;
+	static QHash<QString, db_state*> states;
+	uchar *mapped;
+	qint64 mapped_size;
+	bool map_failed;
+	QByteArray viewbuf;
+	QByteArray readahead;
+	qint64 readahead_offset;
+	quint64 readahead_gen;
+	bool crc_mismatch;
+	bool crc_trusted;
 
 	void init_header(db_header_t *db, int ver, int len, enum pki_type type,
 		QString name);
@@ -58,6 +180,36 @@ class db
 	void fileIOerr(QString s);
 	QString backup_name();
 	bool backup();
+	void attach_state();
+	void detach_state();
+	static void forget_state(const QString &fname);
+	void build_index();
+	void drop_index();
+	void changed();
+	void add_dead(qint64 len);
+	void add_extent(qint64 offset, qint64 len);
+	qint64 take_extent(qint64 len, qint64 *rest);
+	bool free_at(qint64 offset);
+	qint64 lookup(enum pki_type type, QString name);
+	void seek_header(qint64 offset);
+	void unmap();
+	qint64 read_at(qint64 offset, char *p, qint64 len);
+	qint64 resync(qint64 offset);
+	void set_crc(db_header_t *h, const unsigned char *p, int len);
+	void verify_crc(const unsigned char *p, qint64 size);
+	bool index_from_footer();
+	void drop_footer();
+	bool write_footer(QFile &f, QByteArray index, int count,
+			bool extents = true);
+	db_journal *staged() const;
+	qint64 fsize();
+	qint64 read_file(qint64 offset, char *p, qint64 len);
+	qint64 read_full(qint64 offset, char *p, qint64 len);
+	void write_at(qint64 offset, const char *p, qint64 len);
+	bool replay(const QByteArray &ba);
+	void recover();
+	static void sync(QFile &f);
+	static void sync_dir(const QString &fname);
 
     public:
 	bool verify_magic(void);
@@ -75,17 +227,37 @@ class db
 	int set(const unsigned char *p, int len, int ver, enum pki_type type,
 		QString name);
 	unsigned char *load(db_header_t *u_header);
+	const unsigned char *view(db_header_t *u_header);
+	bool crc_error() const
+	{
+		return crc_mismatch;
+	}
+	bool crc_corrupt() const
+	{
+		return crc_mismatch && crc_trusted;
+	}
+	qint64 footer();
+	void save_index();
 	bool get_header(db_header_t *u_header);
 	int erase(void);
-	int shrink(int flags);
+	int dead_ratio(int flags);
+	int shrink(int flags, QAtomicInt *progress = NULL);
 	int mv(QFile &new_file);
+	void begin();
+	void commit();
+	void rollback();
 
+	static uint32_t crc32c(uint32_t crc, const unsigned char *p,
+				size_t len);
 	static QByteArray intToData(uint32_t val);
 	static uint32_t intFromData(QByteArray &ba);
+	static uint32_t intFromData(db_cursor &c);
 	static QByteArray boolToData(bool val);
 	static bool boolFromData(QByteArray &ba);
+	static bool boolFromData(db_cursor &c);
 	static QByteArray stringToData(const QString val);
 	static QString stringFromData(QByteArray &ba);
+	static QString stringFromData(db_cursor &c);
 };
 
 #endif
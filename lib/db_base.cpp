@@ -19,6 +19,9 @@
 #include <QClipboard>
 #include <QDir>
 #include <QDebug>
+#include <QVector>
+#include <QtAlgorithms>
+#include <string.h>
 #include "widgets/MainWindow.h"
 #include "widgets/ImportMulti.h"
 
@@ -29,6 +32,14 @@ db_base::db_base(QString db, MainWindow *mw)
 	rootItem = newPKI();
 	mainwin = mw;
 	colResizing = 0;
+	batch = 0;
+	pending = 0;
+	unfetched = 0;
+	sortCol = 0;
+	sortOrder = Qt::AscendingOrder;
+	resetting = false;
+	silent = false;
+	digestsValid = false;
 	currentIdx = QModelIndex();
 	class_name = "base";
 }
@@ -36,6 +47,7 @@ db_base::db_base(QString db, MainWindow *mw)
 db_base::~db_base()
 {
 	saveHeaderState();
+	qDeleteAll(loadedItems);
 	delete rootItem;
 }
 
@@ -60,16 +72,15 @@ void db_base::remFromCont(QModelIndex &idx)
 	if (!idx.isValid())
 		return;
 	pki_base *pki = static_cast<pki_base*>(idx.internalPointer());
-	pki_base *parent_pki = pki->getParent();
-	int row = pki->row();
 
-	beginRemoveRows(parent(idx), row, row);
-	parent_pki->takeChild(pki);
-	endRemoveRows();
-	emit columnsContentChanged();
+	beginRemove(pki);
+	pki->getParent()->takeChild(pki);
+	endRemove();
+	unindexItem(pki);
+	contentChanged();
 }
 
-int db_base::handleBadEntry(unsigned char *p, db_header_t *head)
+int db_base::handleBadEntry(const unsigned char *p, db_header_t *head)
 {
 	QString name = QString::fromUtf8(head->name);
 	QString txt = tr("Bad database item\nName: %1\nType: %2\nSize: %3\n%4")
@@ -118,81 +129,262 @@ int db_base::handleBadEntry(unsigned char *p, db_header_t *head)
 	return (l == 2);
 }
 
+/* Decode one database item of this model. The item is
+ * added to the container by the following loadContainer().
+ * Returns true if the bad item shall be erased from the database.
+ * An "unverified" checksum mismatch alone does not make an item bad:
+ * Older versions rewrite items in place without updating the checksum.
+ * A "corrupt" item has a mismatch of an authoritative checksum */
+bool db_base::loadItem(const unsigned char *p, db_header_t *head,
+		bool unverified, bool corrupt)
+{
+	if (corrupt) {
+		errorEx err(tr("Checksum mismatch: The item is corrupted"));
+		err.appendString(QString::fromUtf8(head->name));
+		mainwin->Error(err);
+		try {
+			return handleBadEntry(p, head);
+		} catch (errorEx &err) {
+			mainwin->Error(err);
+		}
+		return false;
+	}
+	pki_base *pki = newPKI(head);
+
+	if (pki->getVersion() < head->version) {
+		qWarning("Item[%s]: Version %d "
+			"> known version: %d -> ignored",
+			head->name, head->version,
+			pki->getVersion()
+		);
+		delete pki;
+		return false;
+	}
+	pki->setIntName(QString::fromUtf8(head->name));
+
+	try {
+		pki->fromData(p, head);
+	}
+	catch (errorEx &err) {
+		err.appendString(pki->getIntName());
+		if (unverified)
+			err.appendString(tr("(Checksum mismatch)"));
+		mainwin->Error(err);
+		delete pki;
+		try {
+			return handleBadEntry(p, head);
+		} catch (errorEx &err) {
+			mainwin->Error(err);
+		}
+		return false;
+	}
+	if (unverified)
+		qWarning("Item[%s]: Checksum mismatch, loaded unverified",
+			head->name);
+	loadedItems << pki;
+	return false;
+}
+
+void db_base::loadHeaderState(const unsigned char *p, db_header_t *head)
+{
+	if (head->version != 5)
+		return;
+	QByteArray ba((const char*)p, head->len - sizeof(db_header_t));
+	try {
+		allHeaders.fromData(ba);
+	} catch (errorEx &) {
+		for (int i=0; i< allHeaders.count(); i++) {
+			allHeaders[i]->reset();
+		}
+	}
+}
+
 void db_base::loadContainer()
 {
-	db mydb(dbName);
-	unsigned char *p = NULL;
-	db_header_t head;
+	beginBatch();
+	foreach(pki_base *pki, loadedItems)
+		inToCont(pki);
+	loadedItems.clear();
+	endBatch();
+}
+
+/* Collect the new top level items into one row insertion and
+ * all changes into one columnsContentChanged(). Batches may be
+ * nested. The model stays consistent meanwhile, so dialogs may
+ * be shown and items deleted during a batch */
+void db_base::beginBatch()
+{
+	batch++;
+}
+
+void db_base::endBatch()
+{
+	if (--batch > 0)
+		return;
+	placePending();
+	emit columnsContentChanged();
+}
+
+/* Sort keys are integers or big endian byte arrays of numbers
+ * not fitting into 64 bit */
+static bool keyLessThan(const QVariant &l, const QVariant &r)
+{
+	bool lba = l.type() == QVariant::ByteArray;
+	bool rba = r.type() == QVariant::ByteArray;
+
+	if (!l.isValid() || !r.isValid())
+		return r.isValid();
+	if (lba || rba) {
+		if (!lba || !rba)
+			return rba;
+		QByteArray a = l.toByteArray(), b = r.toByteArray();
+		if (a.size() != b.size())
+			return a.size() < b.size();
+		return memcmp(a.constData(), b.constData(), a.size()) < 0;
+	}
+	if (l.type() == QVariant::ULongLong || r.type() == QVariant::ULongLong)
+		return l.toULongLong() < r.toULongLong();
+	return l.toLongLong() < r.toLongLong();
+}
+
+/* Column values compare by their sort key, if one has any.
+ * Otherwise numeric columns compare by length first */
+static bool valueLessThan(const QVariant &lk, const QVariant &rk,
+		pki_base *l, pki_base *r, dbheader *hd)
+{
+	if (lk.isValid() || rk.isValid())
+		return keyLessThan(lk, rk);
+
+	QVariant ld = l->column_data(hd), rd = r->column_data(hd);
+	if (hd->isNumeric()) {
+		QString ls = ld.toString(), rs = rd.toString();
+		if (ls.size() != rs.size())
+			return ls.size() < rs.size();
+		return ls < rs;
+	}
+	if (!ld.isValid())
+		return false;
+	if (!rd.isValid())
+		return true;
+	return ld.toString() < rd.toString();
+}
+
+/* The order of the views, also used to sort the top level rows */
+bool db_base::lessThan(const QModelIndex &left,
+		const QModelIndex &right) const
+{
+	pki_base *l = static_cast<pki_base*>(left.internalPointer());
+	pki_base *r = static_cast<pki_base*>(right.internalPointer());
+	dbheader *hd = allHeaders[left.column()];
+
+	return valueLessThan(l->sort_key(hd), r->sort_key(hd), l, r, hd);
+}
+
+/* Whether "a" is shown in front of "b" */
+bool db_base::before(pki_base *a, pki_base *b) const
+{
+	dbheader *hd = allHeaders.value(sortCol, allHeaders[0]);
+
+	if (sortOrder == Qt::DescendingOrder)
+		qSwap(a, b);
+	return valueLessThan(a->sort_key(hd), b->sort_key(hd), a, b, hd);
+}
+
+/* Sort key of a top level row, computed once per sortRows() */
+class sortRow
+{
+    public:
 	pki_base *pki;
+	QVariant key;
+};
 
-	for (int i=0; i < pkitype.count(); i++) {
-		mydb.first();
-		while (mydb.find(pkitype[i], QString()) == 0) {
-			QString s;
-			p = mydb.load(&head);
-			if (!p) {
-				qWarning("Load was empty !");
-				goto next;
-			}
-			pki = newPKI(&head);
-			if (pki->getVersion() < head.version) {
-				qWarning("Item[%s]: Version %d "
-					"> known version: %d -> ignored",
-					head.name, head.version,
-					pki->getVersion()
-				);
-				free(p);
-				delete pki;
-				goto next;
-			}
-			pki->setIntName(QString::fromUtf8(head.name));
-
-			try {
-				pki->fromData(p, &head);
-			}
-			catch (errorEx &err) {
-				err.appendString(pki->getIntName());
-				mainwin->Error(err);
-				delete pki;
-				pki = NULL;
-				try {
-					if (handleBadEntry(p, &head)) {
-						mydb.erase();
-					}
-				} catch (errorEx &err) {
-					mainwin->Error(err);
-				}
-			}
-			free(p);
-			if (pki) {
-				inToCont(pki);
-			}
-next:
-			if (mydb.next())
-				break;
-		}
+class sortRowOrder
+{
+	dbheader *hd;
+	bool descending;
+    public:
+	sortRowOrder(dbheader *h, bool d)
+	{
+		hd = h;
+		descending = d;
+	}
+	bool operator()(const sortRow &a, const sortRow &b) const
+	{
+		if (descending)
+			return valueLessThan(b.key, a.key, b.pki, a.pki, hd);
+		return valueLessThan(a.key, b.key, a.pki, b.pki, hd);
+	}
+};
+
+/* Bring all top level rows into the order of the sort column.
+ * Only the first FETCH_CHUNK of them remain visible.
+ * Must be enclosed in beginResetModel() and endResetModel() */
+void db_base::sortRows()
+{
+	QVector<sortRow> rows;
+	dbheader *hd = allHeaders.value(sortCol, allHeaders[0]);
+
+	rows.reserve(rootItem->childCount());
+	while (rootItem->childCount()) {
+		sortRow r;
+		r.pki = rootItem->takeFirst();
+		r.key = r.pki->sort_key(hd);
+		rows << r;
 	}
+	qStableSort(rows.begin(), rows.end(),
+		sortRowOrder(hd, sortOrder == Qt::DescendingOrder));
+	foreach(sortRow r, rows)
+		rootItem->append(r.pki);
+	pending = 0;
+	unfetched = qMax(0, rows.size() - FETCH_CHUNK);
+}
+
+/* Report the pending rows to the views. If rows are held back,
+ * those not sorting in front of them join them instead, so the
+ * views always see the first rows in their order */
+void db_base::placePending()
+{
+	int visible, rows = rootItem->childCount();
 
-	mydb.first();
-	if (!mydb.find(setting, class_name + "_hdView")) {
-		QByteArray ba;
-		char *p;
-		if ((p = (char *)mydb.load(&head))) {
-			ba = QByteArray(p, head.len - sizeof(db_header_t));
-			free(p);
+	if (!pending)
+		return;
+	if (rows > FETCH_CHUNK && pending >= FETCH_CHUNK) {
+		/* Mostly new rows, e.g. after loading */
+		beginResetModel();
+		sortRows();
+		endResetModel();
+		return;
+	}
+	if (!unfetched) {
+		beginInsertRows(QModelIndex(), rows - pending, rows - 1);
+		pending = 0;
+		endInsertRows();
+		return;
+	}
+	visible = rows - pending - unfetched;
+	while (pending) {
+		pki_base *pki = rootItem->child(rootItem->childCount() -1);
+		rootItem->takeChild(pki);
+		pending--;
+		if (!unfetched || before(pki, rootItem->child(visible))) {
+			beginInsertRows(QModelIndex(), 0, 0);
+			rootItem->insert(0, pki);
+			endInsertRows();
+			visible++;
+			continue;
 		}
-		if (head.version != 5)
-			return;
-		try {
-			allHeaders.fromData(ba);
-		}  catch (errorEx()) {
-			for (int i=0; i< allHeaders.count(); i++) {
-				allHeaders[i]->reset();
-			}
+		/* Binary search behind equal rows of the sorted rest */
+		int lo = visible, hi = visible + unfetched;
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			if (before(pki, rootItem->child(mid)))
+				hi = mid;
+			else
+				lo = mid + 1;
 		}
+		rootItem->insert(lo, pki);
+		unfetched++;
 	}
-	emit columnsContentChanged();
-	return;
 }
 
 void db_base::updateHeaders()
@@ -268,6 +460,16 @@ void db_base::sortIndicatorChanged(int logicalIndex, Qt::SortOrder order)
 		allHeaders[i]->sortIndicator = -1;
 	}
 	allHeaders[logicalIndex]->sortIndicator = order;
+
+	if (sortCol == logicalIndex && sortOrder == order)
+		return;
+	sortCol = logicalIndex;
+	sortOrder = order;
+	if (batch || (!unfetched && rootItem->childCount() <= FETCH_CHUNK))
+		return;
+	beginResetModel();
+	sortRows();
+	endResetModel();
 }
 
 void db_base::insertPKI(pki_base *pki)
@@ -283,7 +485,7 @@ void db_base::insertPKI(pki_base *pki)
 			pki->getVersion(), pki->getType(), name);
 	}
 	inToCont(pki);
-	emit columnsContentChanged();
+	contentChanged();
 }
 
 QString db_base::pem2QString(QModelIndexList indexes)
@@ -328,17 +530,55 @@ void db_base::deletePKI(QModelIndex idx)
 			MainWindow::Error(err);
 		}
 
-		remFromCont(idx);
-
+		/* Erase it from the file first: If that fails,
+		 * the item stays in the view */
 		db mydb(dbName);
 		mydb.find(pki->getType(), pki->getIntName());
 		mydb.erase();
+
+		remFromCont(idx);
 		delete pki;
 	} catch (errorEx &err) {
 		MainWindow::Error(err);
 	}
 }
 
+/* Delete all items with one transaction. The views are only
+ * changed after the transaction made it to the file,
+ * if anything fails, the file and the views stay as they were */
+void db_base::deleteSelectedItems(QModelIndexList indexes)
+{
+	db mydb(dbName);
+
+	try {
+		mydb.begin();
+		foreach(QModelIndex idx, indexes) {
+			pki_base *pki =
+				static_cast<pki_base*>(idx.internalPointer());
+			mydb.first();
+			mydb.find(pki->getType(), pki->getIntName());
+			mydb.erase();
+		}
+		mydb.commit();
+	} catch (errorEx &err) {
+		mydb.rollback();
+		MainWindow::Error(err);
+		return;
+	}
+	beginBatch();
+	foreach(QModelIndex idx, indexes) {
+		pki_base *pki = static_cast<pki_base*>(idx.internalPointer());
+		try {
+			pki->deleteFromToken();
+		} catch (errorEx &err) {
+			MainWindow::Error(err);
+		}
+		remFromCont(idx);
+		delete pki;
+	}
+	endBatch();
+}
+
 void db_base::updatePKI(pki_base *pki)
 {
 	db mydb(dbName);
@@ -370,6 +610,18 @@ void db_base::insertChild(pki_base *parent, pki_base *child)
 	if (parent == child || parent == NULL)
 		parent = rootItem;
 
+	/* New top level rows may have to be held back */
+	if (parent == rootItem && !resetting && (batch || unfetched)) {
+		parent->append(child);
+		pending++;
+		if (!batch)
+			placePending();
+		return;
+	}
+	if (resetting || isPending(parent)) {
+		parent->insert(0,child);
+		return;
+	}
 	if (parent != rootItem)
 		idx = index(parent);
 
@@ -381,22 +633,99 @@ void db_base::insertChild(pki_base *parent, pki_base *child)
 void db_base::inToCont(pki_base *pki)
 {
 	insertChild(rootItem, pki);
+	indexItem(pki);
+}
+
+void db_base::indexItem(pki_base *pki)
+{
+	addName(pki);
+	if (digestsValid) {
+		QByteArray d = pki->derDigest();
+		if (!d.isEmpty() && !digests.contains(d, pki))
+			digests.insert(d, pki);
+	}
+}
+
+void db_base::unindexItem(pki_base *pki)
+{
+	removeName(pki);
+	if (digestsValid)
+		digests.remove(pki->derDigest(), pki);
+}
+
+void db_base::addName(pki_base *pki)
+{
+	QString name = pki->getIntName();
+
+	if (!names.contains(name, pki))
+		names.insert(name, pki);
+}
+
+void db_base::removeName(pki_base *pki)
+{
+	names.remove(pki->getIntName(), pki);
+}
+
+/* Rows from the root down to "pki" */
+static QList<int> treePath(pki_base *pki)
+{
+	QList<int> path;
+
+	for (; pki && pki->getParent(); pki = pki->getParent())
+		path.prepend(pki->row());
+	return path;
+}
+
+/* Pre-order: Parents come before their children */
+static bool treeBefore(const QList<int> &a, const QList<int> &b)
+{
+	for (int i = 0; i < a.size() && i < b.size(); i++) {
+		if (a[i] != b[i])
+			return a[i] < b[i];
+	}
+	return a.size() < b.size();
 }
 
+/* Of several items with the same name, the first one in
+ * tree order is returned */
 pki_base *db_base::getByName(QString desc)
 {
-	FOR_ALL_pki(pki, pki_base) {
-		if (pki->getIntName() == desc)
-			return pki;
+	QList<pki_base*> list = names.values(desc);
+	pki_base *best = NULL;
+	QList<int> best_path;
+
+	if (list.size() < 2)
+		return list.isEmpty() ? NULL : list.first();
+	foreach(pki_base *pki, list) {
+		QList<int> path = treePath(pki);
+		if (!best || treeBefore(path, best_path)) {
+			best = pki;
+			best_path = path;
+		}
 	}
-	return NULL;
+	return best;
 }
 
 pki_base *db_base::getByReference(pki_base *refpki)
 {
 	if (refpki == NULL)
 		return NULL;
-	FOR_ALL_pki(pki, pki_base) {
+
+	QByteArray d = refpki->derDigest();
+	if (d.isEmpty()) {
+		FOR_ALL_pki(pki, pki_base) {
+			if (refpki->compare(pki))
+				return pki;
+		}
+		return NULL;
+	}
+	if (!digestsValid) {
+		digests.clear();
+		digestsValid = true;
+		FOR_ALL_pki(pki, pki_base)
+			indexItem(pki);
+	}
+	foreach(pki_base *pki, digests.values(d)) {
 		if (refpki->compare(pki))
 			return pki;
 	}
@@ -488,9 +817,82 @@ int db_base::rowCount(const QModelIndex &parent) const
 	else
 		parentItem = static_cast<pki_base*>(parent.internalPointer());
 
+	if (parentItem == rootItem)
+		return parentItem->childCount() - unfetched - pending;
 	return parentItem->childCount();
 }
 
+bool db_base::canFetchMore(const QModelIndex &parent) const
+{
+	return !parent.isValid() && unfetched > 0;
+}
+
+/* The held back rows are sorted, the next chunk
+ * continues the visible ones */
+void db_base::fetchMore(const QModelIndex &parent)
+{
+	int first, n;
+
+	if (!canFetchMore(parent))
+		return;
+	n = qMin(unfetched, FETCH_CHUNK);
+	first = rowCount(QModelIndex());
+	beginInsertRows(QModelIndex(), first, first + n - 1);
+	unfetched -= n;
+	endInsertRows();
+}
+
+void db_base::fetchAll()
+{
+	int first;
+
+	if (!canFetchMore(QModelIndex()))
+		return;
+	first = rowCount(QModelIndex());
+	beginInsertRows(QModelIndex(), first, first + unfetched - 1);
+	unfetched = 0;
+	endInsertRows();
+}
+
+/* Whether the views do not know "pki": It is below a pending or
+ * unfetched top level item or not linked into the tree at all */
+bool db_base::isPending(pki_base *pki) const
+{
+	if (pki == rootItem)
+		return false;
+	while (pki->getParent() && pki->getParent() != rootItem)
+		pki = pki->getParent();
+	if (!pki->getParent())
+		return true;
+	return pki->row() >= rowCount(QModelIndex());
+}
+
+/* Report the removal of "pki" from its parent,
+ * unless the views do not know it */
+void db_base::beginRemove(pki_base *pki)
+{
+	pki_base *parent = pki->getParent();
+
+	silent = resetting || isPending(pki);
+	if (silent) {
+		if (parent != rootItem || resetting)
+			return;
+		if (pki->row() >= rootItem->childCount() - pending)
+			pending--;
+		else
+			unfetched--;
+		return;
+	}
+	beginRemoveRows(parent == rootItem ? QModelIndex() : index(parent),
+			pki->row(), pki->row());
+}
+
+void db_base::endRemove()
+{
+	if (!silent)
+		endRemoveRows();
+}
+
 int db_base::columnCount(const QModelIndex &) const
 {
 	return allHeaders.count();
@@ -515,7 +917,9 @@ QVariant db_base::data(const QModelIndex &index, int role) const
 		case Qt::BackgroundRole:
 			return item->bg_color(hd);
 		case Qt::UserRole:
-			return item->visible();
+			return item->visible(searchFields());
+		case SORT_KEY_ROLE:
+			return item->sort_key(hd);
 	}
 	return QVariant();
 }
@@ -570,7 +974,9 @@ bool db_base::setData(const QModelIndex &index, const QVariant &value, int role)
 		db mydb(dbName);
 		try {
 			mydb.rename(item->getType(), on, nn);
+			removeName(item);
 			item->setIntName(nn);
+			addName(item);
 			emit dataChanged(index, index);
 			return true;
 		} catch (errorEx &err) {
@@ -668,6 +1074,16 @@ void db_base::columnResetDefaults()
 	emit resetHeader();
 }
 
+/* Fingerprints are only searched, if one of them is shown */
+int db_base::searchFields() const
+{
+	foreach(dbheader *hd, allHeaders) {
+		if (hd->show && hd->isFingerprint())
+			return pki_base::search_fingerprints;
+	}
+	return 0;
+}
+
 bool db_base::isNumericCol(int col) const
 {
 	return allHeaders[col]->isNumeric();
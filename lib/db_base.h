@@ -16,10 +16,14 @@
 #include <QContextMenuEvent>
 #include <QStringList>
 #include <QAbstractItemModel>
+#include <QMultiHash>
 #include "widgets/ExportDialog.h"
 #include "pki_base.h"
 #include "headerlist.h"
 
+#define SORT_KEY_ROLE (Qt::UserRole + 1)
+#define FETCH_CHUNK 1000
+
 #define FOR_ALL_pki(pki, pki_type) \
 	for(pki_type *pki=(pki_type*)rootItem->iterate(); pki; pki=(pki_type*)pki->iterate())
 
@@ -44,7 +48,43 @@ class db_base: public QAbstractItemModel
 		dbheaderList allHeaders;
 		virtual dbheaderList getHeaders();
 		int colResizing;
-		int handleBadEntry(unsigned char *p, db_header_t *head);
+		QList<pki_base*> loadedItems;
+		/* Internal name -> item of all items in the container */
+		QMultiHash<QString, pki_base*> names;
+		/* DER digest -> item, built on the first getByReference() */
+		QMultiHash<QByteArray, pki_base*> digests;
+		bool digestsValid;
+		void addName(pki_base *pki);
+		void removeName(pki_base *pki);
+		void indexItem(pki_base *pki);
+		void unindexItem(pki_base *pki);
+		/* Top level items added during a batch are appended to
+		 * rootItem, but hidden from the views as "pending" rows.
+		 * endBatch() reports them as one insertion */
+		int batch;
+		int pending;
+		/* Large containers keep their top level rows in the order
+		 * of the sort column and show only the first ones. The
+		 * "unfetched" rest lies between them and the pending rows
+		 * and is handed out by fetchMore() */
+		int unfetched;
+		int sortCol;
+		Qt::SortOrder sortOrder;
+		bool before(pki_base *a, pki_base *b) const;
+		void sortRows();
+		void placePending();
+		/* The views are reset by changeView() */
+		bool resetting;
+		bool silent;
+		bool isPending(pki_base *pki) const;
+		void beginRemove(pki_base *pki);
+		void endRemove();
+		void contentChanged()
+		{
+			if (!batch)
+				emit columnsContentChanged();
+		}
+		int handleBadEntry(const unsigned char *p, db_header_t *head);
 		virtual exportType::etype clipboardFormat(QModelIndexList indexes)
 		{
 			(void)indexes;
@@ -62,7 +102,20 @@ class db_base: public QAbstractItemModel
 		pki_base *getByName(QString desc);
 		pki_base *getByReference(pki_base *refpki);
 		pki_base *getByPtr(void *);
+		bool isPkiType(enum pki_type type) const
+		{
+			return pkitype.contains(type);
+		}
+		QString headerStateName() const
+		{
+			return class_name + "_hdView";
+		}
+		bool loadItem(const unsigned char *p, db_header_t *head,
+			bool unverified = false, bool corrupt = false);
+		void loadHeaderState(const unsigned char *p, db_header_t *head);
 		virtual void loadContainer();
+		void beginBatch();
+		void endBatch();
 		QStringList getDesc();
 		virtual pki_base* insert(pki_base *item);
 		virtual void inToCont(pki_base *pki);
@@ -75,6 +128,11 @@ class db_base: public QAbstractItemModel
 		QModelIndex index(pki_base *pki)const;
 		QModelIndex parent(const QModelIndex &index) const;
 		int rowCount(const QModelIndex &parent) const;
+		bool canFetchMore(const QModelIndex &parent) const;
+		void fetchMore(const QModelIndex &parent);
+		void fetchAll();
+		bool lessThan(const QModelIndex &left,
+				const QModelIndex &right) const;
 		int columnCount(const QModelIndex &parent) const;
 		QVariant data(const QModelIndex &index, int role) const;
 		QVariant headerData(int section, Qt::Orientation orientation,
@@ -86,6 +144,7 @@ class db_base: public QAbstractItemModel
 		void insertChild(pki_base *parent, pki_base *child);
 		void createSuccess(pki_base *pki);
 		bool columnHidden(int col) const;
+		int searchFields() const;
 		bool isNumericCol(int col) const;
 		void saveHeaderState();
 		void initHeaderView(QHeaderView *hv);
@@ -22,7 +22,6 @@ db_crl::db_crl(QString db, MainWindow *mw)
 	class_name = "crls";
 	pkitype << revocation;
 	updateHeaders();
-	loadContainer();
 }
 
 dbheaderList db_crl::getHeaders()
@@ -62,8 +61,10 @@ void db_crl::revokeCerts(pki_crl *crl)
 	signer->mergeRevList(revlist);
 	foreach(x509rev revok, revlist) {
 		pki_x509 *crt = signer->getBySerial(revok.getSerial());
-		if (crt)
+		if (crt) {
 			crt->setRevoked(revok);
+			mainwin->certs->propagateTrust(crt);
+		}
 	}
 }
 
@@ -35,7 +35,6 @@ db_key::db_key(QString db, MainWindow *mw)
 	class_name = "keys";
 	pkitype << asym_key << smartCard;
 	updateHeaders();
-	loadContainer();
 }
 
 dbheaderList db_key::getHeaders()
@@ -24,7 +24,6 @@ db_temp::db_temp(QString DBfile, MainWindow *mw)
 	pkitype << tmpl;
 
 	updateHeaders();
-	loadContainer();
 
 	predefs = newPKI();
 	QDir dir;
@@ -22,7 +22,9 @@ bool db_token::setData(const QModelIndex &index, const QVariant &value, int role
 			return true;
 		try {
 			if (item->renameOnToken(slot, nn)) {
+				removeName(item);
 				item->setIntName(nn);
+				addName(item);
 				emit dataChanged(index, index);
 				return true;
 			}
@@ -23,6 +23,12 @@
 #include <QMessageBox>
 #include <QContextMenuEvent>
 #include <QAction>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QVector>
+#include <openssl/sha.h>
+
+#define SIGNER_CACHE_ENTRY (2 * SHA256_DIGEST_LENGTH)
 
 bool db_x509::treeview = true;
 
@@ -32,8 +38,8 @@ db_x509::db_x509(QString DBfile, MainWindow *mw)
 	rootItem->setIntName("[x509 root]");
 	class_name = "certificates";
 	pkitype << x509;
+	legacySigners = false;
 	updateHeaders();
-	loadContainer();
 }
 
 void db_x509::updateAfterCrlLoad(pki_x509 *pki)
@@ -46,9 +52,13 @@ void db_x509::updateAfterCrlLoad(pki_x509 *pki)
 
 void db_x509::updateAfterDbLoad()
 {
+	db mydb(dbName);
+
+	mydb.begin();
 	FOR_ALL_pki(pki, pki_x509) {
 		updateAfterCrlLoad(pki);
 	}
+	mydb.commit();
 }
 
 dbheaderList db_x509::getHeaders()
@@ -75,6 +85,28 @@ pki_base *db_x509::newPKI(db_header_t *)
 	return new pki_x509();
 }
 
+/* Order the possible signers of "client": A key identifier different
+ * from its authority key identifier only moves a candidate to the end,
+ * the identifiers may be wrong. "matching" gets the number of the
+ * candidates in front */
+static QList<pki_x509*> orderByKeyId(pki_x509 *client,
+		const QList<pki_x509*> &candidates, int *matching = NULL)
+{
+	QList<pki_x509*> first, last;
+	QByteArray akid = client->authorityKeyId();
+
+	foreach(pki_x509 *pki, candidates) {
+		QByteArray skid = pki->subjectKeyId();
+		if (akid.isEmpty() || skid.isEmpty() || skid == akid)
+			first << pki;
+		else
+			last << pki;
+	}
+	if (matching)
+		*matching = first.size();
+	return first + last;
+}
+
 pki_x509 *db_x509::findSigner(pki_x509 *client)
 {
 	pki_x509 *signer;
@@ -84,7 +116,10 @@ pki_x509 *db_x509::findSigner(pki_x509 *client)
 	if (client->verify(client)) {
 		return client;
 	}
-	FOR_ALL_pki(pki, pki_x509) {
+	/* Only certificates with our issuer name can be the signer.
+	 * Those with our authority key identifier are tried first */
+	unsigned long hash = X509_issuer_name_hash(client->getCert());
+	foreach(pki_x509 *pki, orderByKeyId(client, subjects.values(hash))) {
 		if (client->verify(pki)) {
 			return pki;
 		}
@@ -92,6 +127,307 @@ pki_x509 *db_x509::findSigner(pki_x509 *client)
 	return NULL;
 }
 
+static bool recursiveSigning(pki_x509 *cert, pki_x509 *client)
+{
+	/* recursive signing check */
+	for (pki_x509 *s = cert->getSigner(); s; s = s->getSigner()) {
+		if (s == s->getSigner()) {
+			return false;
+		}
+		if (s == client) {
+			printf("Recursive signing: '%s' <-> '%s'\n",
+				CCHAR(s->getIntName()),
+				CCHAR(cert->getIntName()));
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Signature checks of a slice of the loaded certificates.
+ * Of several valid signers the one expiring last wins, like
+ * inToCont() moves the childs to the newer certificate. */
+class signerSearch: public QRunnable
+{
+	const QList<pki_x509*> &certs;
+	const QVector<unsigned long> &hashes;
+	const QMultiHash<unsigned long, pki_x509*> &subjects;
+	const QHash<QByteArray, QByteArray> &cache;
+	QVector<pki_x509*> &signers;
+	int from, to;
+
+	/* The signer key is known from the last time: Take the
+	 * certificate with that key and our issuer as subject
+	 * without checking the signature */
+	pki_x509 *cached(pki_x509 *client, unsigned long hash)
+	{
+		pki_x509 *found = NULL;
+		QByteArray key = cache.value(client->derDigest());
+		X509_NAME *issuer = X509_get_issuer_name(client->getCert());
+
+		if (key.isEmpty())
+			return NULL;
+		if (key == client->pubkeyDigest() &&
+		    !X509_NAME_cmp(X509_get_subject_name(client->getCert()),
+				issuer))
+			return client;
+		foreach(pki_x509 *pki, subjects.values(hash)) {
+			if (pki == client || pki->pubkeyDigest() != key)
+				continue;
+			/* Name hashes may collide */
+			if (X509_NAME_cmp(X509_get_subject_name(pki->getCert()),
+					issuer))
+				continue;
+			if (!found || found->getNotAfter() < pki->getNotAfter())
+				found = pki;
+		}
+		return found;
+	}
+
+	/* Candidates with a matching key identifier come first.
+	 * The others are only checked, if none of them signed */
+	pki_x509 *search(pki_x509 *client, unsigned long hash)
+	{
+		pki_x509 *found = cached(client, hash);
+		QList<pki_x509*> candidates;
+		int i, matching;
+
+		if (found)
+			return found;
+		if (client->verify_only(client))
+			return client;
+		candidates = orderByKeyId(client, subjects.values(hash),
+					&matching);
+		for (i = 0; i < candidates.size(); i++) {
+			pki_x509 *pki = candidates[i];
+			if (i == matching && found)
+				break;
+			if (pki == client)
+				continue;
+			if (found && pki->getNotAfter() < found->getNotAfter())
+				continue;
+			if (client->verify_only(pki))
+				found = pki;
+		}
+		return found;
+	}
+    public:
+	signerSearch(const QList<pki_x509*> &c,
+			const QVector<unsigned long> &h,
+			const QMultiHash<unsigned long, pki_x509*> &s,
+			const QHash<QByteArray, QByteArray> &k,
+			QVector<pki_x509*> &r, int f, int t)
+		: certs(c), hashes(h), subjects(s), cache(k), signers(r)
+	{
+		from = f;
+		to = t;
+	}
+	void run()
+	{
+		for (int i = from; i < to; i++) {
+			try {
+				signers[i] = search(certs[i], hashes[i]);
+			} catch (errorEx &) {
+				signers[i] = NULL;
+			}
+		}
+	}
+};
+
+/* Link all certificates read from the database at once:
+ * The signatures are checked on a thread pool, then the tree
+ * and the effective trust are built in one pass */
+void db_x509::loadContainer()
+{
+	QList<pki_x509*> certs;
+	QVector<unsigned long> hashes;
+	QVector<pki_x509*> signers;
+	QThreadPool pool;
+	int i, n, slice;
+
+	foreach(pki_base *pki, loadedItems) {
+		pki_x509 *cert = static_cast<pki_x509*>(pki);
+		cert->setParent(NULL);
+		cert->delSigner(cert->getSigner());
+		indexItem(cert);
+		indexCert(cert);
+		/* The search threads only read the cached values */
+		cert->derDigest();
+		cert->subjectKeyId();
+		cert->authorityKeyId();
+		cert->pubkeyDigest();
+		certs << cert;
+		hashes << X509_issuer_name_hash(cert->getCert());
+	}
+	loadedItems.clear();
+	n = certs.size();
+	signers.fill(NULL, n);
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	/* No locking callbacks are installed */
+	pool.setMaxThreadCount(1);
+#endif
+	slice = n / (pool.maxThreadCount() * 4) + 1;
+	for (i = 0; i < n; i += slice)
+		pool.start(new signerSearch(certs, hashes, subjects,
+				signerCache, signers, i, qMin(i + slice, n)));
+	pool.waitForDone();
+
+	/* Signers are linked before their clients, the file
+	 * may hold a client in front of its issuer */
+	QHash<pki_x509*, int> pos;
+	QVector<bool> linked(n, false);
+	for (i = 0; i < n; i++)
+		pos[certs[i]] = i;
+
+	beginBatch();
+	for (i = 0; i < n; i++) {
+		QList<int> chain;
+		int k = i;
+		while (k != -1 && !linked[k] && !chain.contains(k)) {
+			pki_x509 *s = signers[k];
+			chain.prepend(k);
+			k = s && s != certs[k] ? pos.value(s, -1) : -1;
+		}
+		foreach(k, chain) {
+			linkCerts(certs[k], signers[k]);
+			linked[k] = true;
+		}
+	}
+	calcEffTrust();
+	endBatch();
+
+	/* Drop the entries of certificates deleted meanwhile */
+	QSet<QByteArray> present;
+	foreach(pki_x509 *cert, certs) {
+		present << cert->derDigest();
+		cacheSigner(cert);
+	}
+	QMutableHashIterator<QByteArray, QByteArray> it(signerCache);
+	while (it.hasNext()) {
+		it.next();
+		if (!present.contains(it.key())) {
+			dirtySigners << (uchar)it.key()[0];
+			it.remove();
+		}
+	}
+	saveSignerCache();
+}
+
+/* The bucket settings are named after the cache with the first
+ * byte of the certificate digest appended. A single setting with
+ * all entries is read for compatibility and replaced by buckets */
+void db_x509::loadSignerCache(const unsigned char *p, db_header_t *head)
+{
+	int i, size = head->len - sizeof(db_header_t);
+	bool legacy = QString::fromUtf8(head->name) == signerCacheName();
+
+	if (head->version != 1 || size % SIGNER_CACHE_ENTRY)
+		return;
+	for (i = 0; i < size; i += SIGNER_CACHE_ENTRY) {
+		const char *e = (const char *)p + i;
+		QByteArray d(e, SHA256_DIGEST_LENGTH);
+		signerCache.insert(d, QByteArray(e + SHA256_DIGEST_LENGTH,
+				SHA256_DIGEST_LENGTH));
+		if (legacy)
+			dirtySigners << (uchar)d[0];
+	}
+	if (legacy)
+		legacySigners = true;
+}
+
+/* Update the cache entry of "cert" after linking or removing it */
+void db_x509::cacheSigner(pki_x509 *cert, bool remove)
+{
+	pki_x509 *signer = remove ? NULL : cert->getSigner();
+	QByteArray d = cert->derDigest(), k;
+
+	if (d.size() != SHA256_DIGEST_LENGTH)
+		return;
+	if (signer)
+		k = signer->pubkeyDigest();
+	if (d.size() + k.size() == SIGNER_CACHE_ENTRY) {
+		if (signerCache.value(d) == k)
+			return;
+		signerCache.insert(d, k);
+	} else if (!signerCache.remove(d)) {
+		return;
+	}
+	dirtySigners << (uchar)d[0];
+}
+
+/* Write the buckets with changed entries */
+void db_x509::saveSignerCache()
+{
+	QHash<QByteArray, QByteArray>::const_iterator i;
+	QMap<int, QByteArray> buckets;
+
+	if (dbName.isEmpty() || dirtySigners.isEmpty())
+		return;
+	foreach(int b, dirtySigners)
+		buckets[b] = QByteArray();
+	for (i = signerCache.constBegin(); i != signerCache.constEnd(); ++i) {
+		int b = (uchar)i.key()[0];
+		if (buckets.contains(b))
+			buckets[b] += i.key() + i.value();
+	}
+	db mydb(dbName);
+	foreach(int b, buckets.keys()) {
+		QByteArray &ba = buckets[b];
+		mydb.set((const unsigned char *)ba.constData(), ba.size(), 1,
+			setting, signerCacheName() +
+			QString("_%1").arg(b, 2, 16, QChar('0')));
+	}
+	if (legacySigners) {
+		mydb.first();
+		if (!mydb.find(setting, signerCacheName()))
+			mydb.erase();
+		legacySigners = false;
+	}
+	dirtySigners.clear();
+}
+
+void db_x509::linkCerts(pki_x509 *cert, pki_x509 *signer)
+{
+	pki_base *root = rootItem;
+
+	if (signer && !recursiveSigning(signer, cert)) {
+		cert->setSigner(signer);
+		/* Mutually signed certificates: The signer is not
+		 * linked yet and can not take childs */
+		if (treeview && signer != cert && signer->getParent())
+			root = signer;
+	}
+	insertChild(root, cert);
+	findKey(cert);
+	pki_key *pub = cert->getPubKey();
+	if (pub) {
+		QList<pki_x509super *> reqs = mainwin->reqs->findByPubKey(pub);
+		delete pub;
+
+		foreach(pki_x509super *r, reqs) {
+			((pki_x509req*)r)->setDone();
+		}
+	}
+}
+
+void db_x509::indexCert(pki_x509 *cert)
+{
+	unsigned long s = X509_subject_name_hash(cert->getCert());
+	unsigned long i = X509_issuer_name_hash(cert->getCert());
+
+	if (!subjects.contains(s, cert))
+		subjects.insert(s, cert);
+	if (!issuers.contains(i, cert))
+		issuers.insert(i, cert);
+}
+
+void db_x509::unindexCert(pki_x509 *cert)
+{
+	subjects.remove(X509_subject_name_hash(cert->getCert()), cert);
+	issuers.remove(X509_issuer_name_hash(cert->getCert()), cert);
+}
+
 QStringList db_x509::getPrivateDesc()
 {
 	QStringList x;
@@ -113,24 +449,35 @@ QStringList db_x509::getSignerDesc()
 
 void db_x509::remFromCont(QModelIndex &idx)
 {
-	int row;
 	pki_base *pki = static_cast<pki_base*>(idx.internalPointer());
-	pki_base *parent_pki = pki->getParent();
-	row = pki->row();
 	pki_x509 *child;
 	pki_base *new_parent;
 	QModelIndex new_idx;
 
-	beginRemoveRows(parent(idx), row, row);
-	parent_pki->takeChild(pki);
-	endRemoveRows();
+	beginRemove(pki);
+	pki->getParent()->takeChild(pki);
+	endRemove();
+	unindexItem(pki);
+	unindexCert((pki_x509*)pki);
+	((pki_x509*)pki)->delSigner(((pki_x509*)pki)->getSigner());
+	cacheSigner((pki_x509*)pki, true);
 
 	while (pki->childCount()) {
-		child = (pki_x509*)pki->childItems.takeFirst();
+		child = (pki_x509*)pki->takeFirst();
 		child->delSigner((pki_x509*)pki);
 		new_parent = findSigner(child);
 		insertChild(new_parent, child);
+		propagateTrust(child);
+		cacheSigner(child);
+	}
+	/* Clients outside of our childs, e.g. in the flat view */
+	foreach(child, ((pki_x509*)pki)->getIssued()) {
+		child->delSigner((pki_x509*)pki);
+		findSigner(child);
+		propagateTrust(child);
+		cacheSigner(child);
 	}
+	saveSignerCache();
 	mainwin->crls->removeSigner(pki);
 	pki_key *pub = ((pki_x509*)pki)->getPubKey();
 	if (pub) {
@@ -154,7 +501,8 @@ void db_x509::changeView()
 		return;
 
 	temproot = new pki_base();
-	beginRemoveRows(QModelIndex(), 0, rows -1);
+	beginResetModel();
+	resetting = true;
 	pki_base *pki = rootItem;
 	pki_base *parent;
 	while(pki->childCount()) {
@@ -165,7 +513,6 @@ void db_x509::changeView()
 			pki = parent;
 		}
 	}
-	endRemoveRows();
 
 	treeview = !treeview;
 	if (treeview)
@@ -178,29 +525,47 @@ void db_x509::changeView()
 		inToCont(pki);
 	}
 	delete temproot;
+	sortRows();
+	resetting = false;
+	endResetModel();
+	emit columnsContentChanged();
 }
 
-void db_x509::calcEffTrust()
+void db_x509::propagateTrust(pki_x509 *cert, QSet<pki_x509*> *done)
 {
-	FOR_ALL_pki(pki, pki_x509)
+	QSet<pki_x509*> visited;
+	QList<pki_x509*> todo;
+
+	if (!done)
+		done = &visited;
+	/* Walk the subtree signed by "cert", signers before clients */
+	todo << cert;
+	while (!todo.isEmpty()) {
+		pki_x509 *pki = todo.takeFirst();
+		if (done->contains(pki))
+			continue;
+		done->insert(pki);
 		pki->calcEffTrust();
+		unsigned long hash = X509_subject_name_hash(pki->getCert());
+		foreach(pki_x509 *client, issuers.values(hash)) {
+			if (client != pki && client->getSigner() == pki)
+				todo << client;
+		}
+	}
 }
 
-static bool recursiveSigning(pki_x509 *cert, pki_x509 *client)
+void db_x509::calcEffTrust()
 {
-	/* recursive signing check */
-	for (pki_x509 *s = cert->getSigner(); s; s = s->getSigner()) {
-		if (s == s->getSigner()) {
-			return false;
-		}
-		if (s == client) {
-			printf("Recursive signing: '%s' <-> '%s'\n",
-				CCHAR(s->getIntName()),
-				CCHAR(cert->getIntName()));
-			return true;
-		}
+	QSet<pki_x509*> done;
+
+	FOR_ALL_pki(pki, pki_x509) {
+		pki_x509 *signer = pki->getSigner();
+		if (!signer || signer == pki)
+			propagateTrust(pki, &done);
 	}
-	return false;
+	/* Leftovers of a broken chain */
+	FOR_ALL_pki(pki, pki_x509)
+		propagateTrust(pki, &done);
 }
 
 void db_x509::inToCont(pki_base *pki)
@@ -214,6 +579,8 @@ void db_x509::inToCont(pki_base *pki)
 		root = rootItem;
 
 	insertChild(root, cert);
+	indexItem(cert);
+	indexCert(cert);
 
 	QList<pki_x509 *> childs;
 	/* Search for another certificate (name and key)
@@ -231,9 +598,12 @@ void db_x509::inToCont(pki_base *pki)
 			childs << child;
 		}
 	}
-	/* Search rootItem childs, whether they are ours */
-	foreach(pki_base *_child, rootItem->childItems) {
-		pki_x509 *child = static_cast<pki_x509*>(_child);
+	/* Search rootItem childs issued by our subject name,
+	 * whether they are ours */
+	unsigned long hash = X509_subject_name_hash(cert->getCert());
+	foreach(pki_x509 *child, issuers.values(hash)) {
+		if (child->getParent() != rootItem)
+			continue;
 		if (child == cert || child->getSigner() == child)
 			continue;
 		if (child->verify_only(cert))
@@ -241,20 +611,21 @@ void db_x509::inToCont(pki_base *pki)
 	}
 	/* move collected childs to us */
 	foreach(pki_x509 *child, childs) {
-		int row;
 		if (recursiveSigning(cert, child))
 			continue;
 		if (!child->verify(cert))
 			continue;
-		row = child->row();
-		beginRemoveRows(index(child), row, row);
+		beginRemove(child);
 		child->getParent()->takeChild(child);
-		endRemoveRows();
+		endRemove();
 		if (treeview)
 			insertChild(cert, child);
 		else
 			insertChild(rootItem, child);
 	}
+	cacheSigner(cert);
+	foreach(pki_x509 *child, childs)
+		cacheSigner(child);
 	findKey(cert);
 	pki_key *pub = cert->getPubKey();
 	if (pub) {
@@ -265,7 +636,8 @@ void db_x509::inToCont(pki_base *pki)
 			((pki_x509req*)r)->setDone();
 		}
 	}
-	calcEffTrust();
+	/* Covers the adopted childs, they are signed by us now */
+	propagateTrust(cert);
 }
 
 pki_x509 *db_x509::getBySubject(const x509name &xname, pki_x509 *last)
@@ -315,13 +687,14 @@ a1int db_x509::searchSerial(pki_x509 *signer)
 	if (!signer)
 		return sserial;
 	sserial = signer->getCaSerial();
-	FOR_ALL_pki(pki, pki_x509)
-		if (pki->getSigner() == signer)  {
-			myserial = pki->getSerial();
-			if (sserial < myserial) {
-				sserial = myserial;
-			}
+	if (signer->getSigner() == signer && sserial < signer->getSerial())
+		sserial = signer->getSerial();
+	foreach(pki_x509 *pki, signer->getIssued()) {
+		myserial = pki->getSerial();
+		if (sserial < myserial) {
+			sserial = myserial;
 		}
+	}
 	return sserial;
 }
 
@@ -355,6 +728,7 @@ pki_base *db_x509::insert(pki_base *item)
 	}
 	cert->setCaSerial((cert->getSerial()));
 	insertPKI(cert);
+	saveSignerCache();
 	a1int serial;
 
 	// check the CA serial of the CA of this cert to avoid serial doubles
@@ -857,8 +1231,10 @@ void db_x509::manageRevocations(QModelIndex idx)
 	if (dlg->exec()) {
 		cert->setRevocations(dlg->getRevList());
 		updatePKI(cert);
-		emit columnsContentChanged();
 	}
+	/* "Generate CRL" also sets the revocations */
+	propagateTrust(cert);
+	emit columnsContentChanged();
 }
 
 void db_x509::setTrust(QModelIndexList indexes)
@@ -897,13 +1273,31 @@ void db_x509::setTrust(QModelIndexList indexes)
 	if (newstate == -1) {
 		return;
 	}
-	foreach(QModelIndex idx, indexes) {
-		cert = static_cast<pki_x509*>(idx.internalPointer());
-		if (newstate != cert->getTrust()) {
-			cert->setTrust(newstate);
-			updatePKI(cert);
+	QList<pki_x509*> changed;
+	QList<int> oldstate;
+	db mydb(dbName);
+	try {
+		mydb.begin();
+		foreach(QModelIndex idx, indexes) {
+			cert = static_cast<pki_x509*>(idx.internalPointer());
+			if (newstate != cert->getTrust()) {
+				changed << cert;
+				oldstate << cert->getTrust();
+				cert->setTrust(newstate);
+				updatePKI(cert);
+			}
 		}
+		mydb.commit();
+	} catch (errorEx &err) {
+		/* Nothing was written: Show the old trust again */
+		mydb.rollback();
+		for (int i = 0; i < changed.count(); i++)
+			changed[i]->setTrust(oldstate[i]);
+		MainWindow::Error(err);
 	}
+	foreach(cert, changed)
+		propagateTrust(cert);
+	emit columnsContentChanged();
 }
 
 void db_x509::certRenewal(QModelIndexList indexes)
@@ -915,30 +1309,36 @@ void db_x509::certRenewal(QModelIndexList indexes)
 	CertExtend *dlg = NULL;
 	x509rev r;
 	bool doRevoke = false;
+	QList<pki_x509*> renewed;
 
 	if (indexes.size() == 0)
 		return;
 	QModelIndex idx = indexes[0];
+	db mydb(dbName);
 
-	try {
-		oldcert = static_cast<pki_x509*>(idx.internalPointer());
-		if (!oldcert ||
-				!(signer = oldcert->getSigner()) ||
-				!(signkey = signer->getRefKey()) ||
-				signkey->isPubKey())
-			return;
+	oldcert = static_cast<pki_x509*>(idx.internalPointer());
+	if (!oldcert ||
+			!(signer = oldcert->getSigner()) ||
+			!(signkey = signer->getRefKey()) ||
+			signkey->isPubKey())
+		return;
 
-		CertExtend *dlg = new CertExtend(mainwin, signer);
-		if (!dlg->exec()) {
-			delete dlg;
-			return;
-		}
-		if (dlg->revoke->isChecked()) {
-			Revocation *revoke = new Revocation(mainwin, indexes);
-			doRevoke = revoke->exec();
-			r = revoke->getRevocation();
-			delete revoke;
-		}
+	dlg = new CertExtend(mainwin, signer);
+	if (!dlg->exec()) {
+		delete dlg;
+		return;
+	}
+	if (dlg->revoke->isChecked()) {
+		Revocation *revoke = new Revocation(mainwin, indexes);
+		doRevoke = revoke->exec();
+		r = revoke->getRevocation();
+		delete revoke;
+	}
+	/* All renewals or none: No dialog may show up
+	 * while the transaction is open */
+	beginBatch();
+	try {
+		mydb.begin();
 		foreach(idx, indexes) {
 			oldcert = static_cast<pki_x509*>
 					(idx.internalPointer());
@@ -960,19 +1360,34 @@ void db_x509::certRenewal(QModelIndexList indexes)
 			// and finally sign the cert
 			newcert->sign(signkey, oldcert->getDigest());
 			newcert = (pki_x509 *)insert(newcert);
-			createSuccess(newcert);
+			if (newcert)
+				renewed << newcert;
+			newcert = NULL;
 		}
-		if (doRevoke)
-			do_revoke(indexes, r);
+		mydb.commit();
 	}
 	catch (errorEx &err) {
-		MainWindow::Error(err);
+		mydb.rollback();
 		if (newcert)
 			delete newcert;
-	}
-	if (dlg)
+		foreach(newcert, renewed) {
+			QModelIndex i = index(newcert);
+			remFromCont(i);
+			delete newcert;
+		}
+		renewed.clear();
+		doRevoke = false;
+		endBatch();
 		delete dlg;
-	emit columnsContentChanged();
+		MainWindow::Error(err);
+		return;
+	}
+	endBatch();
+	delete dlg;
+	foreach(newcert, renewed)
+		createSuccess(newcert);
+	if (doRevoke)
+		do_revoke(indexes, r);
 }
 
 
@@ -1011,10 +1426,12 @@ void db_x509::do_revoke(QModelIndexList indexes, const x509rev &r)
 		x509rev rev(r);
 		rev.setSerial(cert->getSerial());
 		cert->setRevoked(rev);
+		propagateTrust(cert);
 		revlist << rev;
 	}
 	parent->mergeRevList(revlist);
 	updatePKI(parent);
+	emit columnsContentChanged();
 }
 
 void db_x509::unRevoke(QModelIndexList indexes)
@@ -1042,6 +1459,7 @@ void db_x509::unRevoke(QModelIndexList indexes)
 		x509rev rev;
 
 		cert->setRevoked(x509rev());
+		propagateTrust(cert);
 		rev.setSerial(cert->getSerial());
 		i = parent->revList.indexOf(rev);
 		if (i != -1)
@@ -11,6 +11,7 @@
 
 #include <QListView>
 #include <QPixmap>
+#include <QSet>
 #include <QTreeWidget>
 #include "widgets/ExportDialog.h"
 #include "db_key.h"
@@ -27,6 +28,19 @@ class db_x509: public db_x509super
 		QPixmap *certicon[4];
 		pki_x509 *get1SelectedCert();
 		dbheaderList getHeaders();
+		/* Subject and issuer name hash -> certificates */
+		QMultiHash<unsigned long, pki_x509*> subjects, issuers;
+		void indexCert(pki_x509 *cert);
+		void unindexCert(pki_x509 *cert);
+		void linkCerts(pki_x509 *cert, pki_x509 *signer);
+		/* Certificate DER digest -> public key digest of its
+		 * signer, as verified before. It is stored in buckets
+		 * by the first byte of the certificate digest */
+		QHash<QByteArray, QByteArray> signerCache;
+		QSet<int> dirtySigners;
+		bool legacySigners;
+		void cacheSigner(pki_x509 *cert, bool remove = false);
+		void saveSignerCache();
 
 	public:
 		static bool treeview;
@@ -35,6 +49,15 @@ class db_x509: public db_x509super
 		pki_x509 *findSigner(pki_x509 *client);
 		void updateAfterDbLoad();
 		void updateAfterCrlLoad(pki_x509 *pki);
+		QString signerCacheName() const
+		{
+			return class_name + "_signers";
+		}
+		bool isSignerCache(const QString &name) const
+		{
+			return name.startsWith(signerCacheName());
+		}
+		void loadSignerCache(const unsigned char *p, db_header_t *head);
 
 		bool updateView();
 		void updateViewAll();
@@ -43,6 +66,8 @@ class db_x509: public db_x509super
 		QStringList getPrivateDesc();
 		QStringList getSignerDesc();
 		void calcEffTrust();
+		void propagateTrust(pki_x509 *cert,
+				QSet<pki_x509*> *done = NULL);
 		QList<pki_x509*> getCerts(bool onlyTrusted);
 		a1int searchSerial(pki_x509 *signer);
 		void writeAllCerts(const QString fname, bool onlyTrusted);
@@ -56,6 +81,7 @@ class db_x509: public db_x509super
 				exportType::etype type, QModelIndexList list);
 		void fillContextMenu(QMenu *menu, const QModelIndex &index);
 		void inToCont(pki_base *pki);
+		void loadContainer();
 		void changeView();
 		a1int getUniqueSerial(pki_x509 *signer);
 		void toToken(QModelIndex idx, bool alwaysSelect);
@@ -21,7 +21,6 @@ db_x509req::db_x509req(QString DBfile, MainWindow *mw)
 	class_name = "requests";
 	pkitype << x509_req;
 	updateHeaders();
-	loadContainer();
 }
 
 dbheaderList db_x509req::getHeaders()
@@ -9,6 +9,7 @@
 #include "func.h"
 #include "exception.h"
 #include "lib/asn1time.h"
+#include "lib/db.h"
 #include "widgets/validity.h"
 #include <openssl/objects.h>
 #include <openssl/asn1.h>
@@ -346,6 +347,18 @@ void *d2i_bytearray(void *(*d2i)(void *, unsigned char **, long),
 	return ret;
 }
 
+void *d2i_bytearray(void *(*d2i)(void *, unsigned char **, long),
+		db_cursor &c)
+{
+	unsigned char *p, *p1;
+	void *ret;
+	p = p1 = (unsigned char *)c.pos();
+	ret = d2i(NULL, &p1, c.left());
+	c.skip(p1-p);
+	openssl_error();
+	return ret;
+}
+
 void _openssl_error(const QString txt, const char *file, int line)
 {
 	QString error;
@@ -16,6 +16,7 @@
 #include "base.h"
 
 class Validity;
+class db_cursor;
 
 QPixmap *loadImg(const char *name);
 QString getPrefix();
@@ -51,6 +52,8 @@ bool _ign_openssl_error(const QString txt, const char *file, int line);
 QByteArray i2d_bytearray(int(*i2d)(const void*, unsigned char**), const void*);
 void *d2i_bytearray(void *(*d2i)(void*, unsigned char**, long),
 		QByteArray &ba);
+void *d2i_bytearray(void *(*d2i)(void*, unsigned char**, long),
+		db_cursor &c);
 BIO *BIO_QBA_mem_buf(QByteArray &a);
 
 #define I2D_VOID(a) ((int (*)(const void *, unsigned char **))(a))
@@ -116,6 +116,16 @@ class dbheader
 			return name == h->name;
 		return id == h->id;
 	}
+	bool isFingerprint() const
+	{
+		switch (id) {
+		case HD_cert_md5fp:
+		case HD_cert_sha1fp:
+		case HD_cert_sha256fp:
+			return true;
+		}
+		return false;
+	}
 	bool isNumeric()
 	{
 		switch (id) {
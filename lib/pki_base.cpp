@@ -10,16 +10,23 @@
 #include "pki_base.h"
 #include "exception.h"
 #include <QString>
+#include <openssl/evp.h>
 
 int pki_base::pki_counter = 0;
 int pki_base::suppress_messages = 0;
 QRegExp pki_base::limitPattern;
+QByteArray pki_base::limitLiteral;
+bool pki_base::limitPlain = true;
 
 pki_base::pki_base(const QString name, pki_base *p)
 {
 	desc = name;
 	class_name = "pki_base";
 	parent = p;
+	pos = 0;
+	firstPos = 0;
+	searchValid = false;
+	searchFields = 0;
 	pki_counter++;
 	childItems.clear();
 	dataVersion=0;
@@ -54,11 +61,67 @@ QString pki_base::getUnderlinedName() const
 	return getIntName().replace(QRegExp("[ &;`/\\\\]+"), "_");
 }
 
-bool pki_base::visible()
+/* Besides the wildcard pattern remember its longest literal part.
+ * Items not containing it are rejected without running the pattern */
+void pki_base::setLimitPattern(const QString &pattern)
 {
+	QString literal, run;
+	bool inSet = false;
+
+	limitPattern = QRegExp(pattern, Qt::CaseInsensitive, QRegExp::Wildcard);
+	limitPlain = true;
+	for (int i = 0; i <= pattern.size(); i++) {
+		QChar c = i < pattern.size() ? pattern[i] : QChar('*');
+		if (inSet) {
+			inSet = c != ']';
+			continue;
+		}
+		if (c == '*' || c == '?' || c == '[') {
+			if (i < pattern.size())
+				limitPlain = false;
+			if (run.size() > literal.size())
+				literal = run;
+			run.clear();
+			inSet = c == '[';
+			continue;
+		}
+		run += c;
+	}
+	limitLiteral = literal.toLower().toUtf8();
+}
+
+QStringList pki_base::searchStrings()
+{
+	return QStringList(getIntName());
+}
+
+/* "fields" selects the optional texts to search, e.g. the
+ * fingerprints, which are only searched if a column shows them */
+bool pki_base::visible(int fields)
+{
+	int from, to;
+
 	if (limitPattern.isEmpty())
 		return true;
-	return getIntName().contains(limitPattern);
+	if (!searchValid || searchFields != fields) {
+		searchFields = fields;
+		QString all = searchStrings().join(QString(QChar(0)));
+		searchText = all.toLower().toUtf8();
+		searchValid = true;
+	}
+	if (!searchText.contains(limitLiteral))
+		return false;
+	if (limitPlain)
+		return true;
+	for (from = 0; from <= searchText.size(); from = to + 1) {
+		to = searchText.indexOf('\0', from);
+		if (to == -1)
+			to = searchText.size();
+		if (QString::fromUtf8(searchText.constData() + from,
+				to - from).contains(limitPattern))
+			return true;
+	}
+	return false;
 }
 
 int pki_base::get_pki_counter()
@@ -75,6 +138,7 @@ QString pki_base::getClassName()
 void pki_base::setIntName(const QString &d)
 {
 	desc = d;
+	clearSearchCache();
 }
 
 void pki_base::fopen_error(const QString fname)
@@ -124,15 +188,32 @@ pki_base *pki_base::child(int row)
 	return childItems.value(row);
 }
 
+void pki_base::renumber(int from)
+{
+	for (int i = from; i < childItems.size(); i++)
+		childItems[i]->pos = firstPos + i;
+}
+
 void pki_base::append(pki_base *item)
 {
+	item->pos = firstPos + childItems.size();
 	childItems.append(item);
 	item->setParent(this);
 }
 
 void pki_base::insert(int row, pki_base *item)
 {
-	childItems.insert(row, item);
+	if (row >= childItems.size()) {
+		append(item);
+		return;
+	}
+	if (row <= 0) {
+		item->pos = --firstPos;
+		childItems.prepend(item);
+	} else {
+		childItems.insert(row, item);
+		renumber(row);
+	}
 	item->setParent(this);
 }
 
@@ -143,34 +224,53 @@ int pki_base::childCount()
 
 int pki_base::row(void) const
 {
-	if (parent)
-		return parent->childItems.indexOf(const_cast<pki_base*>(this));
-	return 0;
+	if (!parent)
+		return 0;
+	int r = pos - parent->firstPos;
+	if (r >= 0 && r < parent->childItems.size() &&
+	    parent->childItems[r] == this)
+		return r;
+	/* childItems was modified directly */
+	return parent->childItems.indexOf(const_cast<pki_base*>(this));
 }
 
+/* Depth first walk: The first child of "this", if "pki" is NULL.
+ * Otherwise the next sibling of "pki" or of its closest ancestor */
 pki_base *pki_base::iterate(pki_base *pki)
 {
-	if (pki == NULL)
-		pki = (childItems.isEmpty()) ? NULL : childItems.first();
-	else
-		pki = childItems.value(pki->row()+1);
+	pki_base *p = this;
 
-	if (pki) {
-		return pki;
+	if (pki == NULL) {
+		if (!childItems.isEmpty())
+			return childItems.first();
+		pki = this;
+		p = parent;
 	}
-	if (!parent) {
-		return NULL;
+	while (p) {
+		pki_base *next = p->childItems.value(pki->row() +1);
+		if (next)
+			return next;
+		pki = p;
+		p = p->parent;
 	}
-	return parent->iterate(this);
+	return NULL;
 }
 
 void pki_base::takeChild(pki_base *pki)
 {
-	childItems.takeAt(pki->row());
+	int row = pki->row();
+
+	if (row == 0) {
+		takeFirst();
+		return;
+	}
+	childItems.takeAt(row);
+	renumber(row);
 }
 
 pki_base *pki_base::takeFirst()
 {
+	firstPos++;
 	return childItems.takeFirst();
 }
 
@@ -209,3 +309,21 @@ bool pki_base::compare(pki_base *refcrl)
 	pki_openssl_error();
 	return ret;
 }
+
+/* SHA-256 of i2d(), calculated once. Empty without DER encoding */
+QByteArray pki_base::derDigest()
+{
+	unsigned char md[EVP_MAX_MD_SIZE];
+	unsigned int n = 0;
+
+	if (!der_digest.isNull())
+		return der_digest;
+	QByteArray ba = i2d();
+	der_digest = QByteArray("");
+	if (ba.isEmpty())
+		return der_digest;
+	if (EVP_Digest(ba.constData(), ba.size(), md, &n, EVP_sha256(), NULL))
+		der_digest = QByteArray((char*)md, n);
+	pki_openssl_error();
+	return der_digest;
+}
@@ -10,6 +10,7 @@
 #define NOCRYPT
 #include <openssl/err.h>
 #include <QString>
+#include <QStringList>
 #include <QListView>
 #include "pkcs11_lib.h"
 #include "db.h"
@@ -32,10 +33,30 @@ class pki_base : public QObject
 		enum pki_type pkiType;
 		/* model data */
 		pki_base *parent;
+		QByteArray der_digest;
+		/* row() is "pos - parent->firstPos". Prepending a child
+		 * or taking the first one only changes firstPos */
+		int pos;
+		int firstPos;
+		/* Lower case UTF-8 of searchStrings(), separated by '\0'.
+		 * "searchFields" are the optional texts it contains */
+		QByteArray searchText;
+		bool searchValid;
+		int searchFields;
+		void renumber(int from);
+		virtual QStringList searchStrings();
+		void clearSearchCache()
+		{
+			searchValid = false;
+			searchText.clear();
+		}
 		void my_error(const QString myerr) const;
 		void fopen_error(const QString fname);
 
 	public:
+		enum search_field {
+			search_fingerprints = 1,
+		};
 		enum msg_type {
 			msg_import,
 			msg_delete,
@@ -44,6 +65,9 @@ class pki_base : public QObject
 		};
 		static int suppress_messages;
 		static QRegExp limitPattern;
+		static QByteArray limitLiteral;
+		static bool limitPlain;
+		static void setLimitPattern(const QString &pattern);
 		QList<pki_base*> childItems;
 		pki_base(const QString d = "", pki_base *p = NULL);
 		virtual void fload(const QString) {};
@@ -56,7 +80,8 @@ class pki_base : public QObject
 			return QByteArray();
 		}
 		virtual bool compare(pki_base *);
-		virtual bool visible();
+		QByteArray derDigest();
+		bool visible(int fields = 0);
 		virtual ~pki_base();
 		QString getIntName() const;
 		QString getUnderlinedName() const;
@@ -82,6 +107,13 @@ class pki_base : public QObject
 		pki_base *takeFirst();
 		virtual QVariant column_data(dbheader *hd);
 		virtual QVariant getIcon(dbheader *hd);
+		/* Typed key to sort the column by, QVariant() sorts
+		 * by column_data() */
+		virtual QVariant sort_key(dbheader *hd)
+		{
+			(void)hd;
+			return QVariant();
+		}
 		const char *className()
 		{
 			return class_name;
@@ -153,6 +153,15 @@ void pki_crl::d2i(QByteArray &ba)
 	}
 }
 
+void pki_crl::d2i(db_cursor &c)
+{
+	X509_CRL *x = (X509_CRL*)d2i_bytearray(D2I_VOID(d2i_X509_CRL), c);
+	if (x) {
+		X509_CRL_free(crl);
+		crl = x;
+	}
+}
+
 QByteArray pki_crl::i2d()
 {
 	return i2d_bytearray(I2D_VOID(i2d_X509_CRL), crl);
@@ -164,11 +173,11 @@ void pki_crl::fromData(const unsigned char *p, db_header_t *head)
 
 	size = head->len - sizeof(db_header_t);
 
-	QByteArray ba((const char*)p, size);
-	d2i(ba);
+	db_cursor c(p, size);
+	d2i(c);
 
-	if (ba.count() > 0) {
-		my_error(tr("Wrong Size %1").arg(ba.count()));
+	if (c.left() > 0) {
+		my_error(tr("Wrong Size %1").arg(c.left()));
 	}
 }
 
@@ -193,19 +202,15 @@ void pki_crl::addV3ext(const x509v3ext &e)
 	pki_openssl_error();
 }
 
-bool pki_crl::visible()
+QStringList pki_crl::searchStrings()
 {
 	extList el;
-	if (pki_x509name::visible())
-		return true;
-	if (getSigAlg().contains(limitPattern))
-		return true;
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
 	el.setStack(X509_CRL_get0_extensions(crl));
 #else
 	el.setStack(crl->crl->extensions);
 #endif
-	return el.search(limitPattern);
+	return pki_x509name::searchStrings() << getSigAlg() << el.values();
 }
 
 void pki_crl::sign(pki_key *key, const EVP_MD *md)
@@ -443,6 +448,24 @@ QVariant pki_crl::column_data(dbheader *hd)
 	return pki_x509name::column_data(hd);
 }
 
+QVariant pki_crl::sort_key(dbheader *hd)
+{
+	switch (hd->id) {
+		case HD_crl_revoked:
+			return QVariant(numRev());
+		case HD_crl_lastUpdate:
+			return QVariant(getLastUpdate().sortKey());
+		case HD_crl_nextUpdate:
+			return QVariant(getNextUpdate().sortKey());
+		case HD_crl_crlnumber:
+			a1int a;
+			if (getCrlNumber(&a))
+				return a.sortKey();
+			return QVariant();
+	}
+	return pki_x509name::sort_key(hd);
+}
+
 QVariant pki_crl::getIcon(dbheader *hd)
 {
 	return hd->id == HD_internal_name ? QVariant(*icon) : QVariant();
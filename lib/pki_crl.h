@@ -63,14 +63,16 @@ class pki_crl: public pki_x509name
 		a1int getVersion();
 		QVariant column_data(dbheader *hd);
 		QVariant getIcon(dbheader *hd);
+		QVariant sort_key(dbheader *hd);
 		virtual QString getMsg(msg_type msg);
 		void d2i(QByteArray &ba);
+		void d2i(db_cursor &c);
 		QByteArray i2d();
 		void setCrlNumber(a1int num);
 		bool getCrlNumber(a1int *num);
 		a1int getCrlNumber();
 		BIO *pem(BIO *, int);
-		bool visible();
+		QStringList searchStrings();
 };
 
 #endif
@@ -422,14 +422,14 @@ void pki_evp::fromData(const unsigned char *p, db_header_t *head)
 	size = head->len - sizeof(db_header_t);
 	version = head->version;
 
-	QByteArray ba((const char*)p, size);
+	db_cursor c(p, size);
 
-	type = db::intFromData(ba);
-	ownPass = db::intFromData(ba);
+	type = db::intFromData(c);
+	ownPass = db::intFromData(c);
 	if (version < 2) {
-		d2i_old(ba, type);
+		d2i_old(c, type);
 	} else {
-		d2i(ba);
+		d2i(c);
 	}
 	pki_openssl_error();
 
@@ -443,7 +443,7 @@ void pki_evp::fromData(const unsigned char *p, db_header_t *head)
 	if (!ptr)
 		throw errorEx(tr("Ignoring unsupported private key"));
 
-	encKey = ba;
+	encKey = c.rest();
 }
 
 EVP_PKEY *pki_evp::decryptKey() const
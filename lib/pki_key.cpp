@@ -70,6 +70,32 @@ void pki_key::d2i_old(QByteArray &ba, int type)
         ba = ba.mid(p1-p);
 }
 
+void pki_key::d2i(db_cursor &c)
+{
+	EVP_PKEY *k = (EVP_PKEY*)d2i_bytearray(D2I_VOID(d2i_PUBKEY), c);
+	pki_openssl_error();
+	if (k) {
+		if (key)
+			EVP_PKEY_free(key);
+		key = k;
+	}
+}
+
+void pki_key::d2i_old(db_cursor &c, int type)
+{
+	const unsigned char *p1 = c.pos();
+	EVP_PKEY *k = d2i_PublicKey(type, NULL, &p1, c.left());
+
+	pki_openssl_error();
+
+	if (k) {
+		if (key)
+			EVP_PKEY_free(key);
+		key = k;
+	}
+	c.skip(p1 - c.pos());
+}
+
 QByteArray pki_key::i2d()
 {
         return i2d_bytearray(I2D_VOID(i2d_PUBKEY), key);
@@ -457,6 +483,13 @@ QVariant pki_key::column_data(dbheader *hd)
 	return pki_base::column_data(hd);
 }
 
+QVariant pki_key::sort_key(dbheader *hd)
+{
+	if (hd->id == HD_key_use)
+		return QVariant(getUcount());
+	return pki_base::sort_key(hd);
+}
+
 BIGNUM *pki_key::ssh_key_data2bn(QByteArray *ba, bool skip)
 {
 	const unsigned char *d = (const unsigned char *)ba->constData();
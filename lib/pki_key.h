@@ -81,6 +81,7 @@ class pki_key: public pki_base
 		}
 		BIO *pem(BIO *, int);
 		QVariant column_data(dbheader *hd);
+		QVariant sort_key(dbheader *hd);
 		QString modulus();
 		QString pubEx();
 		QString subprime();
@@ -88,7 +89,9 @@ class pki_key: public pki_base
 		int ecParamNid();
 		QString ecPubKey();
 		void d2i(QByteArray &ba);
+		void d2i(db_cursor &c);
 		void d2i_old(QByteArray &ba, int type);
+		void d2i_old(db_cursor &c, int type);
 		QByteArray i2d();
 		EVP_PKEY *load_ssh2_key(FILE *fp);
 		void writeSSH2public(QString fname);
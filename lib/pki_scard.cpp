@@ -775,22 +775,22 @@ void pki_scard::fromData(const unsigned char *p, db_header_t *head )
 	size = head->len - sizeof(db_header_t);
         version = head->version;
 
-	QByteArray ba((const char*)p, size);
+	db_cursor c(p, size);
 
-	card_serial = db::stringFromData(ba);
-	card_manufacturer = db::stringFromData(ba);
-	card_label = db::stringFromData(ba);
-	slot_label = db::stringFromData(ba);
-	card_model = db::stringFromData(ba);
+	card_serial = db::stringFromData(c);
+	card_manufacturer = db::stringFromData(c);
+	card_label = db::stringFromData(c);
+	slot_label = db::stringFromData(c);
+	card_model = db::stringFromData(c);
 	if (version < 2)
 		card_model.clear();
-	object_id  = db::stringFromData(ba);
-	int count      = db::intFromData(ba);
+	object_id  = db::stringFromData(c);
+	int count      = db::intFromData(c);
 	mech_list.clear();
 	for (int i=0; i<count; i++)
-		mech_list << db::intFromData(ba);
+		mech_list << db::intFromData(c);
 
-	d2i(ba);
+	d2i(c);
 
 	if (key)
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
@@ -802,8 +802,8 @@ void pki_scard::fromData(const unsigned char *p, db_header_t *head )
 	if (!ptr)
 		throw errorEx(tr("Ignoring unsupported token key"));
 
-	if (ba.count() > 0) {
-		my_error(tr("Wrong Size %1").arg(ba.count()));
+	if (c.left() > 0) {
+		my_error(tr("Wrong Size %1").arg(c.left()));
 	}
 }
 
@@ -896,17 +896,9 @@ QVariant pki_scard::getIcon(dbheader *hd)
 	return hd->id == HD_internal_name ? QVariant(*icon[0]) : QVariant();
 }
 
-bool pki_scard::visible()
+QStringList pki_scard::searchStrings()
 {
-	QStringList sl;
-	if (pki_base::visible())
-		return true;
-
-	sl << card_serial << card_manufacturer << card_model <<
-		card_label << slot_label << object_id;
-	foreach(QString s, sl) {
-		if (s.contains(limitPattern))
-			return true;
-	}
-	return false;
+	return pki_base::searchStrings() << card_serial <<
+		card_manufacturer << card_model << card_label <<
+		slot_label << object_id;
 }
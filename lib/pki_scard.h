@@ -89,7 +89,7 @@ class pki_scard: public pki_key
 		void store_token(slotid slot, EVP_PKEY *pkey);
 		int renameOnToken(slotid slot, QString name);
 		QString getMsg(msg_type msg);
-		bool visible();
+		QStringList searchStrings();
 };
 
 #endif
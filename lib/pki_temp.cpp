@@ -243,53 +243,53 @@ static QString old_eKeyUse2QString(int old)
 
 void pki_temp::fromData(const unsigned char *p, int size, int version)
 {
-	QByteArray ba((const char*)p, size);
-
-	destination = db::stringFromData(ba);
-	bcCrit = db::boolFromData(ba);
-	keyUseCrit = db::boolFromData(ba);
-	eKeyUseCrit = db::boolFromData(ba);
-	subKey = db::boolFromData(ba);
-	authKey = db::boolFromData(ba);
-	ca = db::intFromData(ba);
+	db_cursor c(p, size);
+
+	destination = db::stringFromData(c);
+	bcCrit = db::boolFromData(c);
+	keyUseCrit = db::boolFromData(c);
+	eKeyUseCrit = db::boolFromData(c);
+	subKey = db::boolFromData(c);
+	authKey = db::boolFromData(c);
+	ca = db::intFromData(c);
 	if (version > 5) {
-		pathLen = db::stringFromData(ba);
+		pathLen = db::stringFromData(c);
 	} else {
-		pathLen = QString::number(db::intFromData(ba));
+		pathLen = QString::number(db::intFromData(c));
 		if (pathLen == "0")
 			pathLen = "";
 	}
-	validN = db::intFromData(ba);
-	validM = db::intFromData(ba);
-	keyUse = db::intFromData(ba);
+	validN = db::intFromData(c);
+	validM = db::intFromData(c);
+	keyUse = db::intFromData(c);
 	if (version > 4) {
-		eKeyUse = db::stringFromData(ba);
+		eKeyUse = db::stringFromData(c);
 	} else {
-		int old = db::intFromData(ba);
+		int old = db::intFromData(c);
 		eKeyUse = old_eKeyUse2QString(old);
 	}
-	nsCertType = db::intFromData(ba);
-	subAltName = db::stringFromData(ba);
-	issAltName = db::stringFromData(ba);
-	crlDist = db::stringFromData(ba);
-	nsComment = db::stringFromData(ba);
-	nsBaseUrl = db::stringFromData(ba);
-	nsRevocationUrl = db::stringFromData(ba);
-	nsCARevocationUrl = db::stringFromData(ba);
-	nsRenewalUrl = db::stringFromData(ba);
-	nsCaPolicyUrl = db::stringFromData(ba);
-	nsSslServerName = db::stringFromData(ba);
-	xname.d2i(ba);
-	authInfAcc = db::stringFromData(ba);
-	certPol = db::stringFromData(ba);
-	validMidn = db::boolFromData(ba);
+	nsCertType = db::intFromData(c);
+	subAltName = db::stringFromData(c);
+	issAltName = db::stringFromData(c);
+	crlDist = db::stringFromData(c);
+	nsComment = db::stringFromData(c);
+	nsBaseUrl = db::stringFromData(c);
+	nsRevocationUrl = db::stringFromData(c);
+	nsCARevocationUrl = db::stringFromData(c);
+	nsRenewalUrl = db::stringFromData(c);
+	nsCaPolicyUrl = db::stringFromData(c);
+	nsSslServerName = db::stringFromData(c);
+	xname.d2i(c);
+	authInfAcc = db::stringFromData(c);
+	certPol = db::stringFromData(c);
+	validMidn = db::boolFromData(c);
 	if (version>2)
-		adv_ext = db::stringFromData(ba);
+		adv_ext = db::stringFromData(c);
 	if (version>3)
-		noWellDefined = db::boolFromData(ba);
+		noWellDefined = db::boolFromData(c);
 
-	if (ba.count() > 0) {
-		my_error(tr("Wrong Size %1").arg(ba.count()));
+	if (c.left() > 0) {
+		my_error(tr("Wrong Size %1").arg(c.left()));
 	}
 }
 
@@ -17,6 +17,7 @@
 #include <QMessageBox>
 #include <QDir>
 #include <openssl/rand.h>
+#include <limits.h>
 
 bool pki_x509::dont_colorize_expiries = false;
 bool pki_x509::disable_netscape = false;
@@ -84,6 +85,8 @@ void pki_x509::fromPEM_BIO(BIO *bio, QString name)
 	pki_openssl_error();
 	X509_free(cert);
 	cert = _cert;
+	clearColumnCache();
+	clearKeyIds();
 	autoIntName();
 	if (getIntName().isEmpty())
 		setIntName(rmslashdot(name));
@@ -113,6 +116,8 @@ void pki_x509::fload(const QString fname)
 	}
 	X509_free(cert);
 	cert = _cert;
+	clearColumnCache();
+	clearKeyIds();
 	autoIntName();
 	if (getIntName().isEmpty())
 		setIntName(rmslashdot(fname));
@@ -146,6 +151,18 @@ void pki_x509::init()
 
 void pki_x509::setSerial(const a1int &serial)
 {
+	QByteArray oldkey;
+	bool linked = false;
+
+	/* Keep the index of the signer up to date */
+	if (psigner && psigner != this) {
+		oldkey = getSerial().hashKey();
+		linked = psigner->issued.contains(oldkey, this);
+	}
+
+	if (linked)
+		psigner->issued.remove(oldkey, this);
+	clearColumnCache();
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
 	X509_set_serialNumber(cert, serial.get());
 #else
@@ -155,6 +172,8 @@ void pki_x509::setSerial(const a1int &serial)
 	cert->cert_info->serialNumber = serial.get();
 #endif
 	pki_openssl_error();
+	if (linked)
+		psigner->issued.insert(getSerial().hashKey(), this);
 }
 
 a1int pki_x509::getSerial() const
@@ -164,14 +183,12 @@ a1int pki_x509::getSerial() const
 	return a;
 }
 
+/* The first one linked wins, if the serial is used twice.
+ * values() lists the most recently inserted first */
 pki_x509 *pki_x509::getBySerial(const a1int &a) const
 {
-	foreach(pki_base *p, childItems) {
-		pki_x509 *pki = static_cast<pki_x509 *>(p);
-		if (a == pki->getSerial())
-			return pki;
-	}
-	return NULL;
+	QList<pki_x509*> l = issued.values(a.hashKey());
+	return l.isEmpty() ? NULL : l.last();
 }
 
 #define SERIAL_LEN 8
@@ -272,6 +289,20 @@ void pki_x509::d2i(QByteArray &ba)
 	if (c) {
 		X509_free(cert);
 		cert = c;
+		clearColumnCache();
+		clearKeyIds();
+	}
+	pki_openssl_error();
+}
+
+void pki_x509::d2i(db_cursor &c)
+{
+	X509 *x = (X509*)d2i_bytearray(D2I_VOID(d2i_X509), c);
+	if (x) {
+		X509_free(cert);
+		cert = x;
+		clearColumnCache();
+		clearKeyIds();
 	}
 	pki_openssl_error();
 }
@@ -403,6 +434,7 @@ int pki_x509::renameOnToken(slotid slot, QString name)
 
 void pki_x509::setNotBefore(const a1time &a)
 {
+	clearColumnCache();
 	a1time t(a);
 	X509_set_notBefore(cert, t.get_utc());
 	pki_openssl_error();
@@ -410,6 +442,7 @@ void pki_x509::setNotBefore(const a1time &a)
 
 void pki_x509::setNotAfter(const a1time &a)
 {
+	clearColumnCache();
 	a1time t(a);
 	X509_set_notAfter(cert, t.get_utc());
 	pki_openssl_error();
@@ -453,6 +486,7 @@ x509name pki_x509::getIssuer() const
 
 void pki_x509::setSubject(const x509name &n)
 {
+	clearColumnCache();
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
 	X509_set_subject_name(cert, n.get());
 #else
@@ -466,6 +500,7 @@ void pki_x509::setSubject(const x509name &n)
 
 void pki_x509::setIssuer(const x509name &n)
 {
+	clearColumnCache();
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
 	X509_set_issuer_name(cert, n.get());
 #else
@@ -485,6 +520,8 @@ bool pki_x509::addV3ext(const x509v3ext &e, bool skip_existing)
 		return false;
 	X509_EXTENSION *ext = e.get();
 	X509_add_ext(cert, ext, -1);
+	clearColumnCache();
+	clearKeyIds();
 	X509_EXTENSION_free(ext);
 	pki_openssl_error();
 	return true;
@@ -492,8 +529,11 @@ bool pki_x509::addV3ext(const x509v3ext &e, bool skip_existing)
 
 void pki_x509::delSigner(pki_base *s)
 {
-	if (s == psigner)
-		psigner = NULL;
+	if (!s || s != psigner)
+		return;
+	if (psigner != this)
+		psigner->issued.remove(getSerial().hashKey(), this);
+	psigner = NULL;
 }
 
 bool pki_x509::canSign()
@@ -525,6 +565,7 @@ void pki_x509::sign(pki_key *signkey, const EVP_MD *digest)
 	tkey = signkey->decryptKey();
 	pki_openssl_error();
 	X509_sign(cert, tkey, digest);
+	clearColumnCache();
 	pki_openssl_error();
 	EVP_PKEY_free(tkey);
 	pki_openssl_error();
@@ -538,35 +579,35 @@ void pki_x509::fromData(const unsigned char *p, db_header_t *head)
 	version = head->version;
 	size = head->len - sizeof(db_header_t);
 
-	QByteArray ba((const char*)p, size);
+	db_cursor c(p, size);
 
-	d2i(ba);
+	d2i(c);
 	pki_openssl_error();
-	trust = db::intFromData(ba);
+	trust = db::intFromData(c);
 	if (version < 4) {
 		a1time revoked;
-		isRevoked = db::boolFromData(ba);
-		revoked.d2i(ba);
+		isRevoked = db::boolFromData(c);
+		revoked.d2i(c);
 		if (isRevoked) {
 			revocation.setDate(revoked);
 			revocation.setSerial(getSerial());
 		}
 	}
-	caSerial.setHex(db::stringFromData(ba));
-	caTemplate = db::stringFromData(ba);
-	crlDays = db::intFromData(ba);
-	crlExpiry.d2i(ba);
+	caSerial.setHex(db::stringFromData(c));
+	caTemplate = db::stringFromData(c);
+	crlDays = db::intFromData(c);
+	crlExpiry.d2i(c);
 	if (version > 1)
-		randomSerial = db::boolFromData(ba);
+		randomSerial = db::boolFromData(c);
 	else
 		randomSerial = false;
 	if (version > 2)
-		crlNumber.setHex(db::stringFromData(ba));
+		crlNumber.setHex(db::stringFromData(c));
 	if (version > 2 && version < 4) {
 		// load own revocation info, to tell daddy about it
 		a1time invalDate;
-		QString revoke_reason = db::stringFromData(ba);
-		invalDate.d2i(ba);
+		QString revoke_reason = db::stringFromData(c);
+		invalDate.d2i(c);
 		if (isRevoked) {
 			revocation.setReason(revoke_reason);
 			revocation.setInvalDate(invalDate);
@@ -574,11 +615,11 @@ void pki_x509::fromData(const unsigned char *p, db_header_t *head)
 	}
 	if (version > 3) {
 		x509revList curr(revList);
-		revList.fromBA(ba);
+		revList.fromBA(c);
 		revList.merge(curr);
 	}
-	if (ba.count() > 0) {
-		my_error(tr("Wrong Size %1").arg(ba.count()));
+	if (c.left() > 0) {
+		my_error(tr("Wrong Size %1").arg(c.left()));
 	}
 	pki_openssl_error();
 }
@@ -675,32 +716,43 @@ bool pki_x509::verify(pki_x509 *signer)
 	if ((psigner != NULL) || (signer == NULL))
 		return false;
 	if (verify_only(signer)) {
-		int idx;
-		x509rev r;
-		r.setSerial(getSerial());
-		psigner = signer;
-		psigner->revList.merge(x509revList(revocation));
-		idx = psigner->revList.indexOf(r);
-		if (idx != -1)
-			revocation = psigner->revList[idx];
+		setSigner(signer);
 		return true;
 	}
 	return false;
 }
 
+/* Link to a signer whose signature was already checked */
+void pki_x509::setSigner(pki_x509 *signer)
+{
+	int idx;
+	x509rev r;
+	r.setSerial(getSerial());
+	psigner = signer;
+	if (signer != this &&
+	    !signer->issued.contains(r.getSerial().hashKey(), this))
+		signer->issued.insert(r.getSerial().hashKey(), this);
+	psigner->revList.merge(x509revList(revocation));
+	idx = psigner->revList.indexOf(r);
+	if (idx != -1) {
+		revocation = psigner->revList[idx];
+		clearColumnCache();
+	}
+}
+
 void pki_x509::setRevocations(const x509revList &rl)
 {
 	revList = rl;
 	x509rev rev;
 
-	foreach(pki_base *p, childItems) {
-		pki_x509 *pki = static_cast<pki_x509 *>(p);
+	foreach(pki_x509 *pki, issued) {
 		rev.setSerial(pki->getSerial());
 		int idx = revList.indexOf(rev);
 		if (idx != -1)
 			pki->revocation = revList[idx];
 		else
 			pki->revocation = x509rev();
+		pki->clearColumnCache();
 	}
 }
 
@@ -747,6 +799,7 @@ bool pki_x509::compareNameAndKey(pki_x509 *other)
 void pki_x509::setPubKey(pki_key *key)
 {
 	X509_set_pubkey(cert, key->getPubKey());
+	clearKeyIds();
 	pki_openssl_error();
 }
 
@@ -768,6 +821,54 @@ QString pki_x509::fingerprint(const EVP_MD *digest)
 	return fp;
 }
 
+QByteArray pki_x509::subjectKeyId()
+{
+	if (!skid.isNull())
+		return skid;
+	skid = QByteArray("");
+	ASN1_OCTET_STRING *ski = (ASN1_OCTET_STRING *)X509_get_ext_d2i(
+				cert, NID_subject_key_identifier, NULL, NULL);
+	if (ski) {
+		skid = QByteArray((const char *)ski->data, ski->length);
+		ASN1_OCTET_STRING_free(ski);
+	}
+	pki_ign_openssl_error();
+	return skid;
+}
+
+QByteArray pki_x509::pubkeyDigest()
+{
+	unsigned char md[EVP_MAX_MD_SIZE];
+	unsigned int n = 0;
+
+	if (!keyDigest.isNull())
+		return keyDigest;
+	if (!X509_pubkey_digest(cert, EVP_sha256(), md, &n))
+		n = 0;
+	pki_ign_openssl_error();
+	keyDigest = QByteArray((const char *)md, n);
+	if (keyDigest.isNull())
+		keyDigest = QByteArray("");
+	return keyDigest;
+}
+
+QByteArray pki_x509::authorityKeyId()
+{
+	if (!akid.isNull())
+		return akid;
+	akid = QByteArray("");
+	AUTHORITY_KEYID *id = (AUTHORITY_KEYID *)X509_get_ext_d2i(
+				cert, NID_authority_key_identifier, NULL, NULL);
+	if (id) {
+		if (id->keyid)
+			akid = QByteArray((const char *)id->keyid->data,
+					id->keyid->length);
+		AUTHORITY_KEYID_free(id);
+	}
+	pki_ign_openssl_error();
+	return akid;
+}
+
 bool pki_x509::checkDate()
 {
 	a1time n, b, a;
@@ -870,6 +971,7 @@ bool pki_x509::isRevoked()
 
 void pki_x509::setRevoked(const x509rev &revok)
 {
+	clearColumnCache();
 	revocation = revok;
 	if (revok.isValid()) {
 		setEffTrust(0);
@@ -879,30 +981,25 @@ void pki_x509::setRevoked(const x509rev &revok)
 
 int pki_x509::calcEffTrust()
 {
-	int mytrust = trust;
-	if (mytrust != 1) {
-		efftrust = mytrust;
-		return mytrust;
-	}
-	if (isRevoked()) {
-		efftrust = 0;
-		return 0;
-	}
-	if (getSigner() == this && trust == 1) { // inherit trust, but self signed
-		trust=0;
-		efftrust=0;
-		return 0;
-	}
-	//we must look at the parent certs
+	/* The signers effective trust must be up to date,
+	 * db_x509::propagateTrust() visits signers first.
+	 * A revoked signer passes on no trust: Inheriting
+	 * certificates below a revoked CA are not trusted */
 	pki_x509 *signer = getSigner();
-	while (mytrust == 1 && signer && signer != this) {
-		mytrust = signer->getTrust();
-		signer = signer->getSigner();
-	}
 
-	if (mytrust == 1) mytrust = 0;
-	efftrust = mytrust;
-	return mytrust;
+	if (trust != 1) {
+		efftrust = trust;
+	} else if (isRevoked()) {
+		efftrust = 0;
+	} else if (signer == this) { // inherit trust, but self signed
+		trust = 0;
+		efftrust = 0;
+	} else if (signer) {
+		efftrust = signer->getEffTrust();
+	} else {
+		efftrust = 0;
+	}
+	return efftrust;
 }
 
 void pki_x509::setCrlExpiry(const a1time &time)
@@ -928,7 +1025,7 @@ bool pki_x509::caAndPathLen(bool *ca, a1int *pathlen, bool *hasLen)
 	return true;
 }
 
-QVariant pki_x509::column_data(dbheader *hd)
+QVariant pki_x509::columnValue(dbheader *hd)
 {
 	QString truststatus[] =
 		{ tr("Not trusted"), tr("Trust inherited"), tr("Always Trusted") };
@@ -970,7 +1067,28 @@ QVariant pki_x509::column_data(dbheader *hd)
 			return QVariant("");
 		}
 	}
-	return pki_x509super::column_data(hd);
+	return pki_x509super::columnValue(hd);
+}
+
+QVariant pki_x509::sort_key(dbheader *hd)
+{
+	switch (hd->id) {
+		case HD_cert_serial:
+			return getSerial().sortKey();
+		case HD_cert_notBefore:
+			return QVariant(getNotBefore().sortKey());
+		case HD_cert_notAfter:
+			return QVariant(getNotAfter().sortKey());
+		case HD_cert_revocation:
+			if (isRevoked())
+				return QVariant(revocation.getDate().sortKey());
+			return QVariant(LLONG_MIN);
+		case HD_cert_crl_expire:
+			if (canSign() && !crlExpiry.isUndefined())
+				return QVariant(crlExpiry.sortKey());
+			return QVariant(LLONG_MIN);
+	}
+	return pki_x509super::sort_key(hd);
 }
 
 QVariant pki_x509::getIcon(dbheader *hd)
@@ -1002,21 +1120,15 @@ QVariant pki_x509::getIcon(dbheader *hd)
 	return QVariant(*icon[pixnum]);
 }
 
-bool pki_x509::visible()
+QStringList pki_x509::searchStrings()
 {
-	if (pki_x509super::visible())
-		return true;
-	if (getIssuer().search(limitPattern))
-		return true;
-	if (fingerprint(EVP_md5()).contains(limitPattern))
-		return true;
-	if (fingerprint(EVP_sha1()).contains(limitPattern))
-		return true;
-	if (fingerprint(EVP_sha256()).contains(limitPattern))
-		return true;
-	if (getSerial().toHex().contains(limitPattern))
-		return true;
-	return false;
+	QStringList l = pki_x509super::searchStrings() <<
+		getIssuer().values() << getSerial().toHex();
+
+	if (searchFields & search_fingerprints)
+		l << fingerprint(EVP_md5()) << fingerprint(EVP_sha1()) <<
+			fingerprint(EVP_sha256());
+	return l;
 }
 
 QVariant pki_x509::bg_color(dbheader *hd)
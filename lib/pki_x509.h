@@ -26,6 +26,8 @@ class pki_x509 : public pki_x509super
 		Q_OBJECT
 	private:
 		pki_x509 *psigner;
+		/* Certificates signed by us, by serial hash key */
+		QMultiHash<QByteArray, pki_x509*> issued;
 		a1time crlExpiry;
 		bool randomSerial;
 		int trust;
@@ -37,9 +39,16 @@ class pki_x509 : public pki_x509super
 		X509 *cert;
 		void init();
 		x509rev revocation;
+		/* Computed on first use, Null if unknown */
+		QByteArray skid, akid, keyDigest;
+		void clearKeyIds()
+		{
+			skid = akid = keyDigest = QByteArray();
+		}
 
 	protected:
 		const ASN1_OBJECT *sigAlg();
+		QVariant columnValue(dbheader *hd);
 
 	public:
 		static QPixmap *icon[6];
@@ -76,12 +85,16 @@ class pki_x509 : public pki_x509super
 		void writeCert(const QString fname, bool PEM, bool append = false);
 		bool verify(pki_x509 *signer);
 		bool verify_only(pki_x509 *signer);
+		void setSigner(pki_x509 *signer);
 		pki_key *getPubKey() const;
 		void setPubKey(pki_key *key);
 		pki_x509 *getSigner();
 		void delSigner(pki_base *s);
 		QString fingerprint(const EVP_MD *digest);
 		extList getV3ext();
+		QByteArray subjectKeyId();
+		QByteArray pubkeyDigest();
+		QByteArray authorityKeyId();
 		bool checkDate();
 		bool addV3ext(const x509v3ext &e, bool skip_existing = false);
 		void sign(pki_key *signkey, const EVP_MD *digest);
@@ -98,6 +111,10 @@ class pki_x509 : public pki_x509super
 		void setRevoked(const x509rev &revok);
 		bool isRevoked();
 		pki_x509 *getBySerial(const a1int &a) const;
+		QList<pki_x509*> getIssued() const
+		{
+			return issued.values();
+		}
 		int calcEffTrust();
 		a1int getIncCaSerial();
 		a1int getCaSerial()
@@ -151,13 +168,14 @@ class pki_x509 : public pki_x509super
 		void setCrlExpiry(const a1time &time);
 		bool hasExtension(int nid);
 		bool cmpIssuerAndSerial(pki_x509 *refcert);
-		bool visible();
+		QStringList searchStrings();
 		void updateView();
 		x509v3ext getExtByNid(int nid);
-		QVariant column_data(dbheader *hd);
 		QVariant getIcon(dbheader *hd);
+		QVariant sort_key(dbheader *hd);
 		QByteArray i2d();
 		void d2i(QByteArray &ba);
+		void d2i(db_cursor &c);
 		void deleteFromToken();
 		void deleteFromToken(slotid slot);
 		virtual QString getMsg(msg_type msg);
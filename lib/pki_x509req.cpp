@@ -72,6 +72,7 @@ void pki_x509req::createReq(pki_key *key, const x509name &dn, const EVP_MD *md,
 
 	privkey = key->decryptKey();
 	X509_REQ_sign(request, privkey, md);
+	clearColumnCache();
 	pki_openssl_error();
 	EVP_PKEY_free(privkey);
 }
@@ -106,6 +107,7 @@ void pki_x509req::fromPEM_BIO(BIO *bio, QString name)
 	openssl_error(name);
 	X509_REQ_free(request);
 	request = req;
+	clearColumnCache();
 	autoIntName();
 	if (getIntName().isEmpty())
 		setIntName(rmslashdot(name));
@@ -143,6 +145,7 @@ void pki_x509req::fload(const QString fname)
 	if (_req) {
 		X509_REQ_free(request);
 		request = _req;
+		clearColumnCache();
 	}
 	autoIntName();
 	if (getIntName().isEmpty())
@@ -156,6 +159,7 @@ void pki_x509req::d2i(QByteArray &ba)
 	if (r) {
 		X509_REQ_free(request);
 		request = r;
+		clearColumnCache();
 	}
 }
 
@@ -166,6 +170,28 @@ void pki_x509req::d2i_spki(QByteArray &ba)
         if (s) {
 		NETSCAPE_SPKI_free(spki);
 		spki = s;
+		clearColumnCache();
+	}
+}
+
+void pki_x509req::d2i(db_cursor &c)
+{
+	X509_REQ *r = (X509_REQ*)d2i_bytearray(D2I_VOID(d2i_X509_REQ), c);
+	if (r) {
+		X509_REQ_free(request);
+		request = r;
+		clearColumnCache();
+	}
+}
+
+void pki_x509req::d2i_spki(db_cursor &c)
+{
+	NETSCAPE_SPKI *s = (NETSCAPE_SPKI*)d2i_bytearray(
+				D2I_VOID(d2i_NETSCAPE_SPKI), c);
+	if (s) {
+		NETSCAPE_SPKI_free(spki);
+		spki = s;
+		clearColumnCache();
 	}
 }
 
@@ -195,6 +221,7 @@ void pki_x509req::addAttribute(int nid, QString content)
 
 	ASN1_STRING *a = QStringToAsn1(content, nid);
 	X509_REQ_add1_attr_by_NID(request, nid, a->type, a->data, a->length);
+	clearColumnCache();
 	ASN1_STRING_free(a);
 	openssl_error(QString("'%1' (%2)").arg(content).arg(OBJ_nid2ln(nid)));
 }
@@ -225,6 +252,7 @@ const ASN1_OBJECT *pki_x509req::sigAlg()
 
 void pki_x509req::setSubject(const x509name &n)
 {
+	clearColumnCache();
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
 	X509_REQ_set_subject_name(request, n.get());
 #else
@@ -451,7 +479,7 @@ QString pki_x509req::getAttribute(int nid)
 	return ret.join(", ");
 }
 
-QVariant pki_x509req::column_data(dbheader *hd)
+QVariant pki_x509req::columnValue(dbheader *hd)
 {
 	switch (hd->id) {
 	case HD_req_signed:
@@ -461,7 +489,7 @@ QVariant pki_x509req::column_data(dbheader *hd)
 	case HD_req_chall_pass:
 		return getAttribute(NID_pkcs9_challengePassword);
 	}
-	return pki_x509super::column_data(hd);
+	return pki_x509super::columnValue(hd);
 }
 
 QVariant pki_x509req::getIcon(dbheader *hd)
@@ -488,28 +516,24 @@ QVariant pki_x509req::getIcon(dbheader *hd)
 	return QVariant(*icon[pixnum]);
 }
 
-bool pki_x509req::visible()
+QStringList pki_x509req::searchStrings()
 {
-	if (pki_x509super::visible())
-		return true;
-	if (getAttribute(NID_pkcs9_unstructuredName).contains(limitPattern))
-		return true;
-	if (getAttribute(NID_pkcs9_challengePassword).contains(limitPattern))
-		return true;
-	return false;
+	return pki_x509super::searchStrings() <<
+		getAttribute(NID_pkcs9_unstructuredName) <<
+		getAttribute(NID_pkcs9_challengePassword);
 }
 
 void pki_x509req::oldFromData(unsigned char *p, int size)
 {
-	QByteArray ba((const char *)p, size);
+	db_cursor c(p, size);
 	privkey = NULL;
 
-	d2i(ba);
-	if (ba.count() > 0)
-		d2i_spki(ba);
+	d2i(c);
+	if (c.left() > 0)
+		d2i_spki(c);
 
-	if (ba.count() > 0) {
-		my_error(tr("Wrong Size %1").arg(ba.count()));
+	if (c.left() > 0) {
+		my_error(tr("Wrong Size %1").arg(c.left()));
 	}
 }
 
@@ -32,6 +32,7 @@ class pki_x509req : public pki_x509super
 		NETSCAPE_SPKI *spki;
 		bool done;
 		const ASN1_OBJECT *sigAlg();
+		QVariant columnValue(dbheader *hd);
 
 	public:
 		extList getV3ext();
@@ -62,7 +63,6 @@ class pki_x509req : public pki_x509super
 		void setSubject(const x509name &n);
 		/* SPKAC special functions */
 		ASN1_IA5STRING *spki_challange();
-		QVariant column_data(dbheader *hd);
 		QVariant getIcon(dbheader *hd);
 		void setDone(bool d = true)
 		{
@@ -74,11 +74,13 @@ class pki_x509req : public pki_x509super
 		}
 		virtual QString getMsg(msg_type msg);
 		void d2i(QByteArray &ba);
+		void d2i(db_cursor &c);
 		void d2i_spki(QByteArray &ba);
+		void d2i_spki(db_cursor &c);
 		QByteArray i2d();
 		QByteArray i2d_spki();
 		BIO *pem(BIO *, int);
-		bool visible();
+		QStringList searchStrings();
 };
 
 #endif
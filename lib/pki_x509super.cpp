@@ -62,7 +62,30 @@ const EVP_MD *pki_x509super::getDigest()
 	return EVP_get_digestbyobj(sigAlg());
 }
 
+/* Fingerprints, extensions and names are expensive to render and
+ * only change with the certificate or request itself. */
 QVariant pki_x509super::column_data(dbheader *hd)
+{
+	QHash<int, QVariant>::const_iterator i = colCache.constFind(hd->id);
+	if (i != colCache.constEnd())
+		return i.value();
+
+	QVariant v = columnValue(hd);
+	switch (hd->id) {
+	case HD_internal_name:
+	case HD_x509key_name:
+	case HD_cert_trust:
+	case HD_cert_crl_expire:
+	case HD_req_signed:
+		/* Cheap or depending on other items */
+		break;
+	default:
+		colCache[hd->id] = v;
+	}
+	return v;
+}
+
+QVariant pki_x509super::columnValue(dbheader *hd)
 {
 	if (hd->id == HD_x509key_name) {
 		if (!privkey)
@@ -137,13 +160,10 @@ void pki_x509super::opensslConf(QString fname)
 	fclose(fp);
 }
 
-bool pki_x509super::visible()
+QStringList pki_x509super::searchStrings()
 {
-	if (pki_x509name::visible())
-		return true;
-	if (getSigAlg().contains(limitPattern))
-		return true;
-	return getV3ext().search(limitPattern);
+	return pki_x509name::searchStrings() << getSigAlg() <<
+		getV3ext().values();
 }
 
 // Start class  pki_x509name
@@ -174,9 +194,7 @@ QVariant pki_x509name::column_data(dbheader *hd)
 	return pki_base::column_data(hd);
 }
 
-bool pki_x509name::visible()
+QStringList pki_x509name::searchStrings()
 {
-	if (pki_base::visible())
-		return true;
-	return getSubject().search(limitPattern);
+	return pki_base::searchStrings() << getSubject().values();
 }
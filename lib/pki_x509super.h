@@ -10,6 +10,7 @@
 
 #include <openssl/x509.h>
 #include <openssl/pem.h>
+#include <QHash>
 #include "pki_key.h"
 #include "x509name.h"
 #include "x509v3ext.h"
@@ -24,7 +25,7 @@ class pki_x509name : public pki_base
 	};
 	void autoIntName();
 	QVariant column_data(dbheader *hd);
-	bool visible();
+	QStringList searchStrings();
 };
 
 class pki_x509super : public pki_x509name
@@ -32,9 +33,17 @@ class pki_x509super : public pki_x509name
 		Q_OBJECT
 	protected:
 		pki_key *privkey;
+		/* Rendered column values by header id */
+		QHash<int, QVariant> colCache;
 		virtual const ASN1_OBJECT *sigAlg() {
 			return NULL;
 		}
+		virtual QVariant columnValue(dbheader *hd);
+		void clearColumnCache()
+		{
+			colCache.clear();
+			clearSearchCache();
+		}
 	public:
 		pki_x509super(const QString name = "");
 		virtual ~pki_x509super();
@@ -61,7 +70,7 @@ class pki_x509super : public pki_x509name
 		void delRefKey(pki_key *ref);
 		QVariant column_data(dbheader *hd);
 		void opensslConf(QString fname);
-		bool visible();
+		QStringList searchStrings();
 };
 
 #endif
@@ -185,6 +185,15 @@ void x509name::d2i(QByteArray &ba)
 	}
 }
 
+void x509name::d2i(db_cursor &c)
+{
+	X509_NAME *n = (X509_NAME*)d2i_bytearray(D2I_VOID(d2i_X509_NAME), c);
+	if (n) {
+		X509_NAME_free(xn);
+		xn = n;
+	}
+}
+
 QByteArray x509name::i2d()
 {
 	 return i2d_bytearray(I2D_VOID(i2d_X509_NAME), xn);
@@ -239,14 +248,13 @@ QString x509name::checkLength() const
 	return warn;
 }
 
-bool x509name::search(const QRegExp &pattern)
+QStringList x509name::values() const
 {
+	QStringList sl;
 	int i, max = entryCount();
-	for (i=0; i<max; i++) {
-		if (getEntry(i).contains(pattern))
-			return true;
-	}
-	return false;
+	for (i=0; i<max; i++)
+		sl << getEntry(i);
+	return sl;
 }
 
 QString x509name::taggedValues() const
@@ -12,6 +12,8 @@
 #include <QStringList>
 #include <openssl/x509.h>
 
+class db_cursor;
+
 class x509name
 {
 	private:
@@ -29,6 +31,7 @@ class x509name
 		QString getOid(int i) const;
 		QByteArray i2d();
 		void d2i(QByteArray &ba);
+		void d2i(db_cursor &c);
 		QStringList entryList(int i) const;
 		QString getEntryByNid(int nid ) const;
 		QString getEntry(int i) const;
@@ -44,7 +47,7 @@ class x509name
 		QString getMostPopular() const;
 		QString taggedValues() const;
 		QString hash() const;
-		bool search(const QRegExp &pattern);
+		QStringList values() const;
 };
 
 #endif
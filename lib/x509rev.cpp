@@ -133,6 +133,16 @@ void x509rev::d2i(QByteArray &ba)
 	X509_REVOKED_free(r);
 }
 
+void x509rev::d2i(db_cursor &c)
+{
+	X509_REVOKED *r;
+	r = (X509_REVOKED *)d2i_bytearray(D2I_VOID(d2i_X509_REVOKED), c);
+	if (!r)
+		return;
+	fromREVOKED(r);
+	X509_REVOKED_free(r);
+}
+
 QByteArray x509rev::i2d() const
 {
 	QByteArray ba;
@@ -178,6 +188,18 @@ void x509revList::fromBA(QByteArray &ba)
 	}
 }
 
+void x509revList::fromBA(db_cursor &c)
+{
+	int i, num = db::intFromData(c);
+	x509rev r;
+	clear();
+	merged = false;
+	for (i=0; i<num; i++) {
+		r.d2i(c);
+		append(r);
+	}
+}
+
 QByteArray x509revList::toBA()
 {
 	int i, len = size();
@@ -189,6 +211,31 @@ QByteArray x509revList::toBA()
 	return ba;
 }
 
+void x509revList::reindex() const
+{
+	serials.clear();
+	for (int i = size() -1; i >= 0; i--)
+		serials[at(i).getSerial().hashKey()] = i;
+	indexed = true;
+}
+
+int x509revList::indexOf(const x509rev &r) const
+{
+	if (!indexed)
+		reindex();
+	return serials.value(r.getSerial().hashKey(), -1);
+}
+
+void x509revList::append(const x509rev &r)
+{
+	if (indexed) {
+		QByteArray key = r.getSerial().hashKey();
+		if (!serials.contains(key))
+			serials[key] = size();
+	}
+	list.append(r);
+}
+
 void x509revList::merge(const x509revList &other)
 {
 	foreach(x509rev r, other) {
@@ -8,11 +8,14 @@
 #ifndef __X509REV_H
 #define __X509REV_H
 
+#include <QHash>
 #include <QStringList>
 #include <openssl/x509.h>
 #include "asn1time.h"
 #include "asn1int.h"
 
+class db_cursor;
+
 class x509rev
 {
 	private:
@@ -28,6 +31,7 @@ class x509rev
 	public:
 		static QStringList crlreasons();
 		void d2i(QByteArray &ba);
+		void d2i(db_cursor &c);
 		QByteArray i2d() const;
 		QString getReason() const;
 		bool identical(const x509rev &x) const;
@@ -99,28 +103,98 @@ class x509rev
 		}
 };
 
-class x509revList : public QList<x509rev>
+/* The serial index must follow every change of the list,
+ * so only the mutators that maintain it are offered */
+class x509revList
 {
+	private:
+		QList<x509rev> list;
+		/* Serial hash key -> list position, built on demand */
+		mutable QHash<QByteArray, int> serials;
+		mutable bool indexed;
+		void reindex() const;
+
 	public:
+		typedef QList<x509rev>::const_iterator const_iterator;
 		bool merged;
 		QByteArray toBA();
 		void fromBA(QByteArray &ba);
+		void fromBA(db_cursor &c);
 		void merge(const x509revList &other);
 		bool identical(const x509revList &other) const;
-		x509revList() : QList<x509rev>()
+		int indexOf(const x509rev &r) const;
+		bool contains(const x509rev &r) const
+		{
+			return indexOf(r) != -1;
+		}
+		int size() const
+		{
+			return list.size();
+		}
+		bool isEmpty() const
+		{
+			return list.isEmpty();
+		}
+		const x509rev &at(int i) const
+		{
+			return list.at(i);
+		}
+		const x509rev &operator[] (int i) const
+		{
+			return list.at(i);
+		}
+		const_iterator begin() const
+		{
+			return list.constBegin();
+		}
+		const_iterator end() const
+		{
+			return list.constEnd();
+		}
+		void append(const x509rev &r);
+		x509revList &operator << (const x509rev &r)
+		{
+			append(r);
+			return *this;
+		}
+		x509revList &operator = (const x509revList &r)
+		{
+			list = r.list;
+			merged = r.merged;
+			indexed = false;
+			return *this;
+		}
+		x509rev takeAt(int i)
+		{
+			indexed = false;
+			return list.takeAt(i);
+		}
+		void removeAt(int i)
+		{
+			indexed = false;
+			list.removeAt(i);
+		}
+		void clear()
+		{
+			indexed = false;
+			list.clear();
+		}
+		x509revList()
 		{
 			merged = false;
+			indexed = false;
 		}
-		x509revList(const x509revList &r) : QList<x509rev>(r)
+		x509revList(const x509revList &r) : list(r.list)
 		{
 			merged = r.merged;
+			indexed = false;
 		}
-		x509revList(const x509rev &r) : QList<x509rev>()
+		x509revList(const x509rev &r)
 		{
-			if (r.isValid()) {
-				merged = false;
+			merged = false;
+			indexed = false;
+			if (r.isValid())
 				append(r);
-			}
 		}
 };
 #endif
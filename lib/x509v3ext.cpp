@@ -1040,12 +1040,12 @@ STACK_OF(X509_EXTENSION) *extList::getStack()
 	return sk;
 }
 
-bool extList::search(const QRegExp &pattern)
+QStringList extList::values()
 {
+	QStringList sl;
 	for (int i=0; i < size(); i++)
-		if (at(i).getValue(false).contains(pattern))
-			return true;
-	return false;
+		sl << at(i).getValue(false);
+	return sl;
 }
 QString extList::getHtml(const QString &sep)
 {
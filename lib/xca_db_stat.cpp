@@ -49,7 +49,6 @@ int main(int argc, char *argv[])
 	}
 	try {
 		db mydb(database);
-		unsigned char *p;
 		db_header_t h;
 		int i=0;
 		size_t last_end = 0;
@@ -64,9 +63,10 @@ int main(int argc, char *argv[])
 #define FW_VER 3
 #define FW_SIZE 6
 #define FW_FLAGS 6
+#define FW_CRC 3
 		mydb.first(0);
 		//QString fmt = QString("%1 %2 %3 %4 %5 %6 %7");
-		QString fmt = QString("%1 | %2 | %3 | %4 | %5 | %6 | %7 | %8");
+		QString fmt = QString("%1 | %2 | %3 | %4 | %5 | %6 | %7 | %8 | %9");
 		puts(CCHAR(fmt  .arg("Index", FW_IDX)
 				.arg("Type", FW_TYPE)
 				.arg("Ver", FW_VER)
@@ -74,10 +74,14 @@ int main(int argc, char *argv[])
 				.arg("Length", FW_SIZE)
 				.arg("End", FW_SIZE)
 				.arg("Flags", FW_SIZE)
+				.arg("CRC", FW_CRC)
 				.arg("Name")));
 		while (!mydb.eof()) {
-			p = mydb.load(&h);
-			free(p);
+			const char *crc = "-";
+			mydb.view(&h);
+			if (h.headver >= XDB_HEADVER_CRC)
+				crc = mydb.crc_corrupt() ? "corrupt" :
+					mydb.crc_error() ? "mismatch" : "ok";
 			if (last_end != (size_t)mydb.head_offset)
 				errs << mydb.head_offset;
 			last_end = mydb.head_offset + h.len;
@@ -90,6 +94,7 @@ int main(int argc, char *argv[])
 					.arg(h.len, FW_SIZE, format)
 					.arg(last_end -1, FW_SIZE, format)
 					.arg(h.flags, FW_SIZE)
+					.arg(crc, FW_CRC)
 					.arg(h.name)));
 			if (mydb.next(0))
 				break;
@@ -100,6 +105,9 @@ int main(int argc, char *argv[])
 				puts(CCHAR(QString(" %1").arg(e)));
 			puts("");
 		}
+		if (mydb.footer() >= 0)
+			printf("Index footer at offset: %s\n",
+				CCHAR(QString::number(mydb.footer(), format)));
 	} catch (errorEx &ex) {
 		printf("Exception: '%s'\n", ex.getCString());
 		return 1;
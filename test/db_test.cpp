@@ -0,0 +1,269 @@
+/* vi: set sw=4 ts=4:
+ *
+ * Copyright (C) 2001 - 2015 Christian Hohnstaedt.
+ *
+ * All rights reserved.
+ */
+
+/* Regression tests of the database file: Transactions and their
+ * journal, the index footer with the free extents and mv().
+ * Run in a scratch directory, returns the number of failures */
+
+#include "db.h"
+#include "exception.h"
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <QByteArray>
+#include <QFile>
+
+/* as in lib/db.cpp */
+#define JOURNAL_MAGIC 0xcadb1970
+
+QByteArray filename2bytearray(const QString &fname)
+{
+#ifdef WIN32
+	return fname.toLocal8Bit();
+#else
+	return fname.toUtf8();
+#endif
+}
+
+QString filename2QString(const char *fname)
+{
+#ifdef WIN32
+	return QString::fromLocal8Bit(fname);
+#else
+	return QString::fromUtf8(fname);
+#endif
+}
+
+static int failed = 0;
+
+static void check(bool ok, const char *what)
+{
+	printf("%s: %s\n", ok ? "ok" : "FAIL", what);
+	if (!ok)
+		failed++;
+}
+
+static QString scratch(const char *fname)
+{
+	QString s = QString("__db_test_") + fname + ".xdb";
+	QFile::remove(s);
+	QFile::remove(s + "{journal}");
+	return s;
+}
+
+static void put(db &d, QString name, int len, char fill)
+{
+	QByteArray ba(len, fill);
+	d.set((const unsigned char *)ba.constData(), len, 1, setting, name);
+}
+
+/* Payload of the entry "name" or an empty array */
+static QByteArray get(db &d, QString name)
+{
+	db_header_t h;
+	QByteArray ba;
+
+	d.first();
+	if (d.find(setting, name))
+		return ba;
+	unsigned char *p = d.load(&h);
+	if (p) {
+		ba = QByteArray((char *)p, h.len - sizeof h);
+		free(p);
+	}
+	return ba;
+}
+
+static void test_transaction()
+{
+	QString fname = scratch("trans");
+	{
+		db d(fname);
+		put(d, "a", 10, 'a');
+	}
+	{
+		db d(fname);
+		d.begin();
+		put(d, "a", 20, 'A');
+		put(d, "b", 10, 'b');
+		check(get(d, "a") == QByteArray(20, 'A'),
+			"staged writes are visible");
+		d.rollback();
+		check(get(d, "a") == QByteArray(10, 'a'),
+			"rollback restores the old entry");
+	}
+	{
+		db d(fname);
+		check(get(d, "a") == QByteArray(10, 'a') &&
+			get(d, "b").isEmpty(),
+			"rollback leaves the file unchanged");
+		d.begin();
+		put(d, "a", 20, 'A');
+		put(d, "b", 10, 'b');
+		d.commit();
+	}
+	{
+		db d(fname);
+		check(get(d, "a") == QByteArray(20, 'A') &&
+			get(d, "b") == QByteArray(10, 'b'),
+			"commit writes all staged entries");
+	}
+	check(!QFile::exists(fname + "{journal}"),
+		"commit removes the journal");
+	QFile::remove(fname);
+}
+
+/* Journal of a commit(), that was interrupted before the file
+ * got written: Append a new entry "name" at "offs" */
+static QByteArray journal(qint64 offs, QString name, int len)
+{
+	db_header_t h;
+	QByteArray item, ba;
+	uint32_t crc;
+
+	memset(&h, 0, sizeof h);
+	h.magic = htonl(XCA_MAGIC);
+	h.len = htonl(sizeof h + len);
+	h.headver = htons(1);
+	h.type = htons(setting);
+	h.version = htons(1);
+	strncpy(h.name, name.toUtf8().constData(), CRC_OFFSET);
+	item = QByteArray((char *)&h, sizeof h) + QByteArray(len, 'j');
+
+	ba += db::intToData(JOURNAL_MAGIC);
+	ba += db::intToData(1);
+	ba += db::intToData(offs >> 32);
+	ba += db::intToData(offs & 0xffffffff);
+	ba += db::intToData(item.size());
+	ba += item;
+	crc = htonl(db::crc32c(0, (const unsigned char *)ba.constData(),
+				ba.size()));
+	ba += QByteArray((char *)&crc, sizeof crc);
+	return ba;
+}
+
+static void write_journal(QString fname, QByteArray ba)
+{
+	QFile jf(fname + "{journal}");
+
+	if (jf.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		jf.write(ba);
+		jf.close();
+	}
+}
+
+static void test_replay()
+{
+	QString fname = scratch("replay");
+	qint64 size;
+	{
+		db d(fname);
+		put(d, "a", 10, 'a');
+	}
+	size = QFile(fname).size();
+
+	QByteArray ba = journal(size, "j", 30);
+	ba[ba.size() - 1] = ba[ba.size() - 1] ^ 1;
+	write_journal(fname, ba);
+	{
+		db d(fname);
+		check(get(d, "j").isEmpty() && QFile(fname).size() == size,
+			"a damaged journal is not applied");
+	}
+	check(!QFile::exists(fname + "{journal}"),
+		"a damaged journal is discarded");
+
+	write_journal(fname, journal(size, "j", 30));
+	{
+		db d(fname);
+		check(get(d, "j") == QByteArray(30, 'j') &&
+			get(d, "a") == QByteArray(10, 'a'),
+			"an interrupted commit gets completed");
+	}
+	check(!QFile::exists(fname + "{journal}"),
+		"the replayed journal is removed");
+	QFile::remove(fname);
+}
+
+static void test_footer()
+{
+	QString fname = scratch("footer");
+	/* A fresh name has no shared state: The footer gets read */
+	QString copy = scratch("footer_copy");
+	{
+		db d(fname);
+		put(d, "a", 200, 'a');
+		put(d, "b", 10, 'b');
+		/* The old "a" at offset 0 gets free */
+		put(d, "a", 300, 'A');
+		d.save_index();
+	}
+	QFile::copy(fname, copy);
+	{
+		db d(copy);
+		check(d.footer() >= 0, "the footer is found");
+		check(d.dead_ratio(DBFLAG_FREE) > 0,
+			"the dead bytes are read from the footer");
+		check(get(d, "a") == QByteArray(300, 'A') &&
+			get(d, "b") == QByteArray(10, 'b'),
+			"the entries are found through the footer");
+		put(d, "c", 200, 'c');
+		d.first();
+		check(d.find(setting, "c") == 0 && d.head_offset == 0,
+			"a free extent from the footer gets reused");
+	}
+	{
+		db d(copy);
+		check(get(d, "a") == QByteArray(300, 'A') &&
+			get(d, "b") == QByteArray(10, 'b') &&
+			get(d, "c") == QByteArray(200, 'c'),
+			"all entries survive the reuse");
+	}
+	QFile::remove(fname);
+	QFile::remove(copy);
+}
+
+static void test_mv()
+{
+	QString fname = scratch("mv");
+	QString newname = scratch("mv_new");
+	{
+		db d(newname);
+		put(d, "new", 10, 'n');
+	}
+	{
+		db d(fname);
+		put(d, "old", 10, 'o');
+		/* Fill the shared index */
+		check(get(d, "old") == QByteArray(10, 'o'),
+			"the old file is indexed");
+		QFile f(newname);
+		check(d.mv(f) == 0, "mv succeeds");
+	}
+	{
+		db d(fname);
+		check(get(d, "new") == QByteArray(10, 'n') &&
+			get(d, "old").isEmpty(),
+			"the moved file is read after a reopen");
+	}
+	check(!QFile::exists(newname), "the new file is renamed");
+	QFile::remove(fname);
+}
+
+int main(int, char *[])
+{
+	try {
+		test_transaction();
+		test_replay();
+		test_footer();
+		test_mv();
+	} catch (errorEx &err) {
+		printf("FAIL: %s\n", CCHAR(err.getString()));
+		failed++;
+	}
+	return failed;
+}
@@ -0,0 +1,16 @@
+TEMPLATE = app
+TARGET = db_test
+DEPENDPATH += . ../lib
+INCLUDEPATH += . .. ../lib
+QT += core
+CONFIG += console
+
+# Input
+HEADERS += ../local.h \
+           ../lib/db.h \
+           ../lib/base.h \
+           ../lib/func.h \
+           ../lib/exception.h
+
+SOURCES += db_test.cpp \
+           ../lib/db.cpp
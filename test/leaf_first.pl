@@ -0,0 +1,58 @@
+#!/usr/bin/perl
+
+use strict;
+use warnings;
+
+use X11::GUITest qw/StartApp WaitWindowViewable SendKeys WaitWindowClose/;
+
+# A certificate stored before its issuer gets linked to it,
+# once the issuer is loaded. Reopening such a database must
+# neither crash nor lose the chain.
+
+my $xcaId;
+my $password = "ThisIsMyPassword";
+my $db = "__leaf_first.xdb";
+my $dir = "__leaf_first";
+unlink $db;
+mkdir $dir;
+
+sub openssl {
+  system("openssl @_ >/dev/null 2>&1") == 0 or die "openssl @_ failed\n";
+}
+
+openssl("req -x509 -newkey rsa:2048 -nodes -subj /CN=leaf_first_ca",
+	"-keyout $dir/ca.key -out $dir/ca.crt -days 30");
+openssl("req -newkey rsa:2048 -nodes -subj /CN=leaf_first_leaf",
+	"-keyout $dir/leaf.key -out $dir/leaf.csr");
+openssl("x509 -req -in $dir/leaf.csr -CA $dir/ca.crt -CAkey $dir/ca.key",
+	"-set_serial 2 -out $dir/leaf.crt -days 30");
+
+# The leaf comes first in the import list and in the file
+StartApp("./xca -d $db $dir/leaf.crt $dir/ca.crt");
+WaitWindowViewable("New Password");
+SendKeys($password . "{TAB}" . $password . "{ENT}");
+# The import dialog shows up before the main window
+my ($id) = WaitWindowViewable("X Certificate and Key management");
+SendKeys("%(a)");
+SendKeys("%(d)");
+WaitWindowClose($id, 10);
+($xcaId) = WaitWindowViewable("X Certificate and Key management");
+SendKeys("%({F4})");
+WaitWindowClose($xcaId, 10) or die "xca did not exit\n";
+
+my $dump = `lib/xca_db_stat $db`;
+if (index($dump, "leaf_first_leaf") > index($dump, "leaf_first_ca")) {
+  print "SKIP: the leaf was not stored before its issuer\n";
+  exit 0;
+}
+
+StartApp("./xca -d $db");
+WaitWindowViewable("Password");
+SendKeys($password . "{ENT}");
+($xcaId) = WaitWindowViewable("X Certificate and Key management");
+SendKeys("%({F4})");
+WaitWindowClose($xcaId, 10) or die "xca crashed or hung on reopening\n";
+
+unlink glob("$dir/*");
+rmdir $dir;
+exec("lib/xca_db_stat", $db);
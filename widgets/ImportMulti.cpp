@@ -150,10 +150,18 @@ void ImportMulti::on_butRemove_clicked()
 
 void ImportMulti::on_butOk_clicked()
 {
-	while (mcont->rootItem->childCount()) {
-		QModelIndex idx = mcont->index(0, 0, QModelIndex());
-		import(idx);
+	if (!mainwin->keys)
+		mainwin->load_database();
+	batchImport(true);
+	try {
+		while (mcont->rootItem->childCount()) {
+			QModelIndex idx = mcont->index(0, 0, QModelIndex());
+			import(idx);
+		}
+	} catch (errorEx &err) {
+		mainwin->Error(err);
 	}
+	batchImport(false);
 	accept();
 }
 
@@ -163,11 +171,19 @@ void ImportMulti::on_butImport_clicked()
 	QModelIndexList indexes = selectionModel->selectedIndexes();
 	QModelIndex index;
 
-	foreach(index, indexes) {
-		if (index.column() != 0)
-			continue;
-		import(index);
+	if (!mainwin->keys)
+		mainwin->load_database();
+	batchImport(true);
+	try {
+		foreach(index, indexes) {
+			if (index.column() != 0)
+				continue;
+			import(index);
+		}
+	} catch (errorEx &err) {
+		mainwin->Error(err);
 	}
+	batchImport(false);
 }
 
 void ImportMulti::on_deleteToken_clicked()
@@ -222,6 +238,30 @@ static db_base *select_db(QString cn)
 	return NULL;
 }
 
+/* Report the whole import as one update per model
+ * instead of one row insertion per item. The items are
+ * written one by one: Importing may ask for passwords or
+ * report duplicates, which must not happen while a
+ * transaction holds back the writes of the other views */
+void ImportMulti::batchImport(bool start)
+{
+	db_base *dbs[] = { mcont, MainWindow::keys, MainWindow::certs,
+			MainWindow::reqs, MainWindow::crls, MainWindow::temps };
+
+	if (!start) {
+		foreach(db_base *db, batched)
+			db->endBatch();
+		batched.clear();
+		return;
+	}
+	for (unsigned i = 0; i < ARRAY_SIZE(dbs); i++) {
+		if (!dbs[i])
+			continue;
+		dbs[i]->beginBatch();
+		batched << dbs[i];
+	}
+}
+
 pki_base *ImportMulti::import(QModelIndex &idx)
 {
 
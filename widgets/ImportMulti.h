@@ -24,7 +24,9 @@ class ImportMulti: public QDialog, private Ui::ImportMulti
 		slotid slot;
 		db_token *mcont;
 		MainWindow *mainwin;
+		QList<db_base *> batched;
 		void importError(QStringList failed);
+		void batchImport(bool start);
 
 	public:
 		ImportMulti(MainWindow *parent);
@@ -15,11 +15,44 @@
 #include <QDebug>
 #include <QStatusBar>
 #include <QMessageBox>
+#include <QProgressBar>
+#include <QLayout>
+#include <QThread>
 #include "lib/db_base.h"
 #include "lib/func.h"
 #include "widgets/ImportMulti.h"
 #include "widgets/NewKey.h"
 
+/* Default percentage of deleted and outdated data in the database,
+ * that triggers a compaction on close. New items reuse the space of
+ * outdated ones, so only files without any notable waste are skipped */
+#define COMPACT_RATIO 2
+
+class compactThread: public QThread
+{
+public:
+	errorEx err;
+	QString dbfile;
+	int ratio;
+	int ret;
+	QAtomicInt progress;
+
+	void run()
+	{
+		int flags = DBFLAG_OUTDATED | DBFLAG_DELETED;
+		ret = 0;
+		try {
+			db mydb(dbfile);
+			if (mydb.dead_ratio(flags) >= ratio)
+				ret = mydb.shrink(flags, &progress);
+			else
+				mydb.save_index();
+		} catch (errorEx &e) {
+			err = e;
+		}
+	}
+};
+
 void MainWindow::set_geometry(char *p, db_header_t *head)
 {
 	if (head->version != 1)
@@ -34,9 +67,58 @@ void MainWindow::set_geometry(char *p, db_header_t *head)
 		tabView->setCurrentIndex(i);
 }
 
+/* Read the database in a single pass: Items are decoded by the
+ * model handling their type, settings are collected for later */
+void MainWindow::read_database(QList<QPair<db_header_t, QByteArray> > &settings)
+{
+	QList<db_base*> models;
+	db_header_t head;
+	db mydb(dbfile);
+
+	models << keys << reqs << certs << temps << crls;
+
+	while (!mydb.eof()) {
+		const unsigned char *p = mydb.view(&head);
+		if (!p) {
+			qWarning("Load was empty !");
+		} else if (head.type == setting) {
+			QString key = QString::fromUtf8(head.name);
+			bool hdView = false;
+			foreach(db_base *model, models) {
+				if (key == model->headerStateName()) {
+					model->loadHeaderState(p, &head);
+					hdView = true;
+				}
+			}
+			/* what a stupid idea.... */
+			if (key == "multiple_key_use" || key == "suppress")
+				mydb.erase();
+			else if (certs->isSignerCache(key))
+				certs->loadSignerCache(p, &head);
+			else if (!hdView && key != XDB_INDEX_NAME)
+				settings << qMakePair(head, QByteArray((const char*)p,
+						head.len - sizeof(db_header_t)));
+		} else {
+			foreach(db_base *model, models) {
+				if (!model->isPkiType((enum pki_type)head.type))
+					continue;
+				if (model->loadItem(p, &head, mydb.crc_error(),
+						mydb.crc_corrupt()))
+					mydb.erase();
+				break;
+			}
+		}
+		if (mydb.next())
+			break;
+	}
+	foreach(db_base *model, models)
+		model->loadContainer();
+}
+
 int MainWindow::init_database()
 {
 	int ret = 2;
+	QList<QPair<db_header_t, QByteArray> > settings;
 	qDebug("Opening database: %s", QString2filename(dbfile));
 	keys = NULL; reqs = NULL; certs = NULL; temps = NULL; crls = NULL;
 
@@ -52,6 +134,7 @@ int MainWindow::init_database()
 		certs = new db_x509(dbfile, this);
 		temps = new db_temp(dbfile, this);
 		crls = new db_crl(dbfile, this);
+		read_database(settings);
 		certs->updateAfterDbLoad();
 	}
 	catch (errorEx &err) {
@@ -66,6 +149,7 @@ int MainWindow::init_database()
 	mandatory_dn = "";
 	explicit_dn = explicit_dn_default;
 
+	compact_ratio = COMPACT_RATIO;
 	string_opt = QString("MASK:0x2002");
 	ASN1_STRING_set_default_mask_asc((char*)CCHAR(string_opt));
 	hashBox::resetDefault();
@@ -105,57 +189,38 @@ int MainWindow::init_database()
 	certView->setModel(certs);
 	tempView->setModel(temps);
 	crlView->setModel(crls);
-	try {
-		db mydb(dbfile);
-
-		while (mydb.find(setting, QString()) == 0) {
-			QString key;
-			db_header_t head;
-			char *p = (char *)mydb.load(&head);
-			if (!p) {
-				if (mydb.next())
-					break;
-				continue;
-			}
-			key = head.name;
-
-			if (key == "workingdir")
-				workingdir = p;
-			else if (key == "pkcs11path")
-				pkcs11path = p;
-			else if (key == "default_hash")
-				hashBox::setDefault(p);
-			else if (key == "mandatory_dn")
-				mandatory_dn = p;
-			else if (key == "explicit_dn")
-				explicit_dn = p;
-			/* what a stupid idea.... */
-			else if (key == "multiple_key_use")
-				mydb.erase();
-			else if (key == "string_opt")
-				string_opt = p;
-			else if (key == "suppress")
-				mydb.erase();
-			else if (key == "optionflags1")
-				setOptFlags((QString(p)));
-			/* Different optionflags, since setOptFlags()
-			 * does an abort() for unknown flags in
-			 * older versions.   *Another stupid idea*
-			 * This is for backward compatibility
-			 */
-			else if (key == "optionflags")
-				setOptFlags_old((QString(p)));
-			else if (key == "defaultkey")
-				NewKey::setDefault((QString(p)));
-			else if (key == "mw_geometry")
-				set_geometry(p, &head);
-			free(p);
-			if (mydb.next())
-				break;
-		}
-	} catch (errorEx &err) {
-		Error(err);
-		return ret;
+	for (int i = 0; i < settings.count(); i++) {
+		db_header_t *head = &settings[i].first;
+		char *p = settings[i].second.data();
+		QString key = head->name;
+
+		if (key == "workingdir")
+			workingdir = p;
+		else if (key == "pkcs11path")
+			pkcs11path = p;
+		else if (key == "default_hash")
+			hashBox::setDefault(p);
+		else if (key == "mandatory_dn")
+			mandatory_dn = p;
+		else if (key == "explicit_dn")
+			explicit_dn = p;
+		else if (key == "string_opt")
+			string_opt = p;
+		else if (key == "optionflags1")
+			setOptFlags((QString(p)));
+		/* Different optionflags, since setOptFlags()
+		 * does an abort() for unknown flags in
+		 * older versions.   *Another stupid idea*
+		 * This is for backward compatibility
+		 */
+		else if (key == "optionflags")
+			setOptFlags_old((QString(p)));
+		else if (key == "defaultkey")
+			NewKey::setDefault((QString(p)));
+		else if (key == "mw_geometry")
+			set_geometry(p, head);
+		else if (key == "compact_ratio")
+			compact_ratio = QString(p).toInt();
 	}
 	ASN1_STRING_set_default_mask_asc((char*)CCHAR(string_opt));
 	if (explicit_dn.isEmpty())
@@ -208,7 +273,6 @@ void MainWindow::undelete()
 		mydb.get_header(&head);
 		if (head.flags & DBFLAG_DELETED) {
 			pki_base *item;
-			unsigned char *p = NULL;
 			QString name = QString::fromUtf8(head.name);
 			switch (head.type) {
 			case asym_key: item = new pki_evp(name); break;
@@ -220,7 +284,7 @@ void MainWindow::undelete()
 			default: continue;
 			}
 			try {
-				p = mydb.load(&head);
+				const unsigned char *p = mydb.view(&head);
 				item->fromData(p, &head);
 				dlgi->addItem(item);
 			}
@@ -228,7 +292,6 @@ void MainWindow::undelete()
 				Error(err);
 				delete item;
 			}
-			free(p);
 		}
 	}
 	if (dlgi->entries() > 0) {
@@ -285,7 +348,9 @@ void MainWindow::default_database()
 
 }
 
-void MainWindow::close_database()
+/* Not "interactive" while the main window gets destroyed:
+ * No events are processed and no dialogs shown */
+void MainWindow::close_database(bool interactive)
 {
 	QByteArray ba;
 	if (!dbfile.isEmpty()) {
@@ -331,16 +396,50 @@ void MainWindow::close_database()
 
 
 	try {
-		int ret;
-		db mydb(dbfile);
-		ret = mydb.shrink( DBFLAG_OUTDATED | DBFLAG_DELETED );
-		if (ret == 1)
-			XCA_INFO(tr("Errors detected and repaired while deleting outdated items from the database. A backup file was created"));
-		if (ret == 2)
-			XCA_INFO(tr("Removing deleted or outdated items from the database failed."));
+		QString msg;
+		compactThread ct;
+
+		ct.dbfile = dbfile;
+		ct.ratio = compact_ratio;
+		ct.start();
+		if (interactive) {
+			QProgressBar *bar = new QProgressBar();
+			check_oom(bar);
+			bar->setMinimum(0);
+			bar->setMaximum(100);
+			statusBar()->addPermanentWidget(bar, 1);
+			bar->show();
+			if (statusBar()->layout())
+				statusBar()->layout()->activate();
+			/* No event loop: Nothing may run on the
+			 * models and views being torn down */
+			while (!ct.wait(20)) {
+				bar->setValue(ct.progress.fetchAndAddRelaxed(0));
+				bar->repaint();
+			}
+			statusBar()->removeWidget(bar);
+			delete bar;
+		} else {
+			ct.wait();
+		}
+		if (!ct.err.isEmpty())
+			throw errorEx(ct.err);
+		if (ct.ret == 1)
+			msg = tr("Errors detected and repaired while deleting outdated items from the database. A backup file was created");
+		if (ct.ret == 2)
+			msg = tr("Removing deleted or outdated items from the database failed.");
+		if (!msg.isEmpty()) {
+			if (interactive)
+				XCA_INFO(msg);
+			else
+				qWarning("%s", CCHAR(msg));
+		}
 	}
 	catch (errorEx &err) {
-		MainWindow::Error(err);
+		if (interactive)
+			MainWindow::Error(err);
+		else
+			qWarning("%s", CCHAR(err.getString()));
 	}
 	update_history(dbfile);
 	pkcs11::remove_libs();
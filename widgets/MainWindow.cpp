@@ -546,7 +546,7 @@ void MainWindow::manageToken()
 
 MainWindow::~MainWindow()
 {
-	close_database();
+	close_database(false);
 	ERR_free_strings();
 	EVP_cleanup();
 	OBJ_cleanup();
@@ -702,6 +702,7 @@ QString MainWindow::updateDbPassword(QString newdb, Passwd pass)
 		if (mydb.next())
 			break;
 	}
+	mydb.begin();
 	for (int i=0; i< klist.count(); i++) {
 		pki_evp *key = klist[i];
 		QByteArray ba = key->toData();
@@ -709,6 +710,7 @@ QString MainWindow::updateDbPassword(QString newdb, Passwd pass)
 			key->getVersion(), key->getType(), key->getIntName());
 		delete key;
 	}
+	mydb.commit();
 	return passhash;
 }
 
@@ -82,6 +82,7 @@ class MainWindow: public QMainWindow, public Ui::MainWindow
 		tipMenu *historyMenu;
 		void update_history_menu();
 		void set_geometry(char *p, db_header_t *head);
+		void read_database(QList<QPair<db_header_t, QByteArray> > &settings);
 		QLineEdit *searchEdit;
 		QStringList urlsToOpen;
 		int checkOldGetNewPass(Passwd &pass);
@@ -91,6 +92,7 @@ class MainWindow: public QMainWindow, public Ui::MainWindow
 		void init_images();
 		void init_menu();
 		int force_load;
+		int compact_ratio;
 		NIDlist *read_nidlist(QString name);
 		QLabel *statusLabel;
 		QString homedir;
@@ -150,7 +152,7 @@ class MainWindow: public QMainWindow, public Ui::MainWindow
 		int init_database();
 		void new_database();
 		void load_database();
-		void close_database();
+		void close_database(bool interactive = true);
 		void dump_database();
 		void default_database();
 		void connNewX509(NewX509 *nx);
@@ -8,28 +8,30 @@
 #include "XcaProxyModel.h"
 #include "lib/db_base.h"
 
+XcaProxyModel::XcaProxyModel(QWidget *parent)
+	:QSortFilterProxyModel(parent)
+{
+	connect(this, SIGNAL(layoutChanged()), this, SLOT(clearRowPaths()));
+	connect(this, SIGNAL(modelReset()), this, SLOT(clearRowPaths()));
+	connect(this, SIGNAL(rowsInserted(const QModelIndex &, int, int)),
+		this, SLOT(clearRowPaths()));
+	connect(this, SIGNAL(rowsRemoved(const QModelIndex &, int, int)),
+		this, SLOT(clearRowPaths()));
+}
+
+void XcaProxyModel::clearRowPaths()
+{
+	rowPaths.clear();
+}
+
+/* The same order as the top level rows of large containers */
 bool XcaProxyModel::lessThan(const QModelIndex &left,
 		const QModelIndex &right) const
 {
 	db_base *db = (db_base *)sourceModel();
 	if (!db)
 		return QSortFilterProxyModel::lessThan(left, right);
-
-	if (db->isNumericCol(left.column()) &&
-	    db->isNumericCol(right.column()))
-	{
-		int diff;
-		QString l = sourceModel()->data(left).toString();
-		QString r = sourceModel()->data(right).toString();
-		diff = l.size() - r.size();
-		if (diff<0)
-			return true;
-		else if (diff>0)
-			return false;
-		else
-			return l < r;
-	}
-	return QSortFilterProxyModel::lessThan(left, right);
+	return db->lessThan(left, right);
 }
 
 bool XcaProxyModel::filterAcceptsRow(int sourceRow,
@@ -50,10 +52,18 @@ QVariant XcaProxyModel::data(const QModelIndex &index, int role) const
 	/* Row number */
 	switch (role) {
 		case Qt::EditRole:
-		case Qt::DisplayRole:
+		case Qt::DisplayRole: {
+			QPair<void *, int> key(index.internalPointer(),
+						index.row());
+			QHash<QPair<void *, int>, QString>::const_iterator it =
+				rowPaths.constFind(key);
+			if (it != rowPaths.constEnd())
+				return QVariant(it.value());
 			for (i = index; i.isValid(); i = i.parent())
 				number += QString(" %1").arg(i.row()+1);
+			rowPaths.insert(key, number);
 			return QVariant(number);
+		}
 		default:
 			return QSortFilterProxyModel::data(index, role);
 	}
@@ -11,17 +11,26 @@
 #include <QWidget>
 #include <QItemSelectionModel>
 #include <QSortFilterProxyModel>
+#include <QHash>
+#include <QPair>
 
 class XcaProxyModel: public QSortFilterProxyModel
 {
 	Q_OBJECT
+
+	/* "No." column texts by parent mapping and row,
+	 * valid until the next layout change */
+	mutable QHash<QPair<void *, int>, QString> rowPaths;
+
    public:
-	XcaProxyModel(QWidget *parent = 0)
-		:QSortFilterProxyModel(parent) { }
+	XcaProxyModel(QWidget *parent = 0);
 	bool lessThan(const QModelIndex &left, const QModelIndex &right) const;
 	bool filterAcceptsRow(int sourceRow,
 			const QModelIndex &sourceParent) const;
 	QVariant data(const QModelIndex &index, int role) const;
+
+   private slots:
+	void clearRowPaths();
 };
 
 #endif
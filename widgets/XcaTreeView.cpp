@@ -17,6 +17,9 @@
 #include <QVariant>
 #include <QRegExp>
 
+#define COL_SAMPLE_ROWS 500
+#define FILTER_DELAY 250
+
 
 XcaTreeView::XcaTreeView(QWidget *parent)
 	:QTreeView(parent)
@@ -31,6 +34,8 @@ XcaTreeView::XcaTreeView(QWidget *parent)
     setAnimated(true);
 
 	proxy = new XcaProxyModel(this);
+	filterTimer.setSingleShot(true);
+	connect(&filterTimer, SIGNAL(timeout()), this, SLOT(applyFilter()));
 	setSortingEnabled(true);
 	proxy->setDynamicSortFilter(true);
 	sortByColumn(0, Qt::AscendingOrder);
@@ -74,6 +79,9 @@ void XcaTreeView::showHideSections()
 	}
 	basemodel->colResizeEnd();
 	columnsResize();
+	/* The shown columns decide, what the filter searches */
+	if (!filterPattern.isEmpty())
+		proxy->invalidate();
 }
 
 void XcaTreeView::setMainwin(MainWindow *mw, QLineEdit *filter)
@@ -87,6 +95,13 @@ void XcaTreeView::setModel(QAbstractItemModel *model)
 {
 	QByteArray ba;
 
+	/* The old model may be deleted right after */
+	filterTimer.stop();
+	if (basemodel) {
+		disconnect(header(), 0, basemodel, 0);
+		disconnect(basemodel, 0, this, 0);
+		disconnect(basemodel, 0, proxy, 0);
+	}
 	basemodel = (db_base *)model;
 	proxy->setSourceModel(model);
 	QTreeView::setModel(proxy);
@@ -144,16 +159,68 @@ QModelIndexList XcaTreeView::getSelectedIndexes()
 	return list;
 }
 
+/* The rows currently shown plus top level rows spread over
+ * the whole list, but never more than 2 * COL_SAMPLE_ROWS */
+QModelIndexList XcaTreeView::sampleRows()
+{
+	QModelIndexList rows;
+	QModelIndex idx = indexAt(QPoint(0, 0));
+	int i, cnt, step, height = viewport()->height();
+
+	for (i = 0; idx.isValid() && i < COL_SAMPLE_ROWS; i++) {
+		if (visualRect(idx).top() > height)
+			break;
+		rows << idx;
+		idx = indexBelow(idx);
+	}
+	cnt = proxy->rowCount(QModelIndex());
+	step = cnt / COL_SAMPLE_ROWS + 1;
+	for (i = 0; i < cnt; i += step)
+		rows << proxy->index(i, 0, QModelIndex());
+	return rows;
+}
+
+int XcaTreeView::sampledColumnWidth(int col, const QModelIndexList &rows)
+{
+	QStyleOptionViewItem opt = viewOptions();
+	bool first = header()->visualIndex(col) == 0;
+	int width = 0;
+
+	foreach(QModelIndex idx, rows) {
+		QModelIndex cell = idx.sibling(idx.row(), col);
+		int w = itemDelegate(cell)->sizeHint(opt, cell).width();
+		if (first) {
+			int depth = rootIsDecorated() ? 1 : 0;
+			for (idx = idx.parent(); idx.isValid(); idx = idx.parent())
+				depth++;
+			w += depth * indentation();
+		}
+		width = qMax(width, w);
+	}
+	if (!header()->isHidden())
+		width = qMax(width, header()->sectionSizeHint(col));
+	return width;
+}
+
+/* Size the columns on a sample of rows instead of asking every row
+ * for its content. A double click on the section handle still
+ * measures all rows of that column. */
 void XcaTreeView::columnsResize()
 {
 	int cnt, i;
+	QModelIndexList rows;
+
 	if (!basemodel)
 		return;
 	cnt = basemodel->columnCount(QModelIndex());
+	rows = sampleRows();
 	basemodel->colResizeStart();
 	for (i=0; i<cnt; i++) {
-		if (!basemodel->fixedHeaderSize(i)) {
-			resizeColumnToContents(i);
+		if (!basemodel->fixedHeaderSize(i) &&
+		    !header()->isSectionHidden(i))
+		{
+			header()->resizeSection(i,
+				sampledColumnWidth(i, rows));
 		}
 	}
 	basemodel->colResizeEnd();
@@ -185,12 +252,21 @@ void XcaTreeView::editIdx()
 	edit(getProxyIndex(currentIndex()));
 }
 
+/* Filter only after typing paused for FILTER_DELAY ms */
 void XcaTreeView::setFilter(const QString &pattern)
 {
-	pki_base::limitPattern = QRegExp(pattern,
-			Qt::CaseInsensitive, QRegExp::Wildcard);
+	filterPattern = pattern;
+	filterTimer.start(FILTER_DELAY);
+}
+
+void XcaTreeView::applyFilter()
+{
+	/* Rows not fetched yet must be searched, too */
+	if (basemodel && !filterPattern.isEmpty())
+		basemodel->fetchAll();
+	pki_base::setLimitPattern(filterPattern);
 	// Only to tell the model about the changed filter
-	proxy->setFilterFixedString(pattern);
+	proxy->setFilterFixedString(filterPattern);
 }
 
 void XcaTreeView::deleteItems(void)
@@ -219,9 +295,7 @@ void XcaTreeView::deleteItems(void)
 	if (!XCA_OKCANCEL(msg))
 		return;
 
-	foreach(index, indexes) {
-		basemodel->deletePKI(index);
-	}
+	basemodel->deleteSelectedItems(indexes);
 }
 
 void XcaTreeView::storeItems(void)
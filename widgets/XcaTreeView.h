@@ -12,6 +12,7 @@
 #include <QHeaderView>
 #include <QItemSelectionModel>
 #include <QSortFilterProxyModel>
+#include <QTimer>
 #include "lib/db_base.h"
 
 class XcaTreeView: public QTreeView
@@ -19,6 +20,10 @@ class XcaTreeView: public QTreeView
 	Q_OBJECT
 
 	dbheader *curr_hd;
+	QTimer filterTimer;
+	QString filterPattern;
+	QModelIndexList sampleRows();
+	int sampledColumnWidth(int col, const QModelIndexList &rows);
 
    protected:
 	db_base *basemodel;
@@ -52,6 +57,7 @@ class XcaTreeView: public QTreeView
 	void columnsResize();
 	void editIdx();
 	void setFilter(const QString &pattern);
+	void applyFilter();
 	void deleteItems(void);
 	void storeItems(void);
 	void showItems(void);